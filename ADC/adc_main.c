@@ -1,58 +1,411 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <string.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <avr/sleep.h>
 
-volatile unsigned char sample_flag = 1;
-volatile unsigned int analog_temp = 0; 
-volatile unsigned char hyperText[32];
+#ifndef F_CPU
+#define F_CPU 16000000UL // 16 MHz clk
+#endif
 
-#define CR  0x0D
-#define LF  0x0A // Line feed
-#define SPACE 0x20
+// screen /dev/cu.usbserial 9600
+// press Ctrl+a, type :quit and press Enter.
+#define USART0_TX_BUFFER_SIZE   64
+#define USART0_RX_BUFFER_SIZE   8   // single-letter commands
+#define USART0_TX_CRLF
+#define PROFILER_TIMER          3   // free Timer3 for the ISR profiler (-DPROFILER)
+#include "../common/usart_2560.h"
+#include "../common/power_2560.h"
+#include "../common/format.h"
+
+/*
+  Sampling engine: Timer1 Compare Match B auto-triggers every conversion, so
+  the sample rate has no software jitter. ADC_vect only stores the 10-bit
+  result in one of two blocks (ping-pong); when a block is full it is handed
+  to the main loop and the ISR carries on filling the other one. The main
+  loop then works on whole blocks (min/max/mean/RMS).
+
+  Scan sequencer: adc_scan[] lists the channels to convert. After each
+  conversion ADC_vect stores the result in that entry's ring, picks the next
+  entry that is due and switches ADMUX / MUX5 for the next trigger. An entry
+  with decimation N is only converted on every Nth pass over the list, so a
+  slow thermistor takes almost no converter time from a fast signal. Entries
+  with discard_first throw away the first conversion after the channel or
+  reference changed (it has not settled, e.g. the 1.1 V bandgap).
+  The first entry also feeds the blocks above.
+
+  Oversampling: an entry with oversample = n stays selected for 4^n
+  conversions, ADC_vect adds them up in a 32-bit accumulator and stores
+  sum >> n, a (10 + n)-bit result. This needs at least 1 LSB of noise on the
+  input (there normally is). Result rate of one entry while it is converting:
+      n   bits  samples   at 1 kHz trigger   at 9.6 kHz (max, ADC clk 125 kHz)
+      0   10    1         1000 Hz            9615 Hz
+      1   11    4          250 Hz            2404 Hz
+      2   12    16        62.5 Hz             601 Hz
+      3   13    64        15.6 Hz             150 Hz
+      4   14    256        3.9 Hz            37.6 Hz
+  (other due entries share the trigger, so divide by their share of it)
+  The block entry must keep n <= 2, the block sums are 32 bit.
 
+  ADC_NOISE_REDUCTION (compile-time option): instead of auto-triggering,
+  TIMER1_COMPB_vect flags the main loop, which starts each conversion by
+  entering ADC Noise Reduction sleep, so the CPU and I/O clocks are stopped
+  while the ADC samples. USART0 also stops in that mode, so while it still
+  has bytes to send the conversion is started with ADSC instead.
+  The receiver stops too: a byte arriving during a sleep would lose bits
+  (FE0 / wrong data), and at 1 kHz every byte overlaps a sleep. A pin change
+  on RXD0 (PCINT8, asynchronous, wakes the CPU within a few cycles of the
+  start bit's falling edge) starts ADC_RX_AWAKE_TICKS trigger periods
+  without sleeping, renewed by every edge, so a line is received with the
+  clock running and sleeping resumes once it has been quiet.
+  Timer1 is clocked by clkIO as well and stands still while the CPU sleeps,
+  so each sleeping period is longer by the sleep time (about the 108 us
+  conversion): about 900 Hz instead of 1 kHz, and exactly 1 kHz again while
+  the ADSC path runs (USART0 busy). adc_time and the block rate count
+  trigger periods, not milliseconds, in this mode.
+
+  Watchdog events: every result is compared with its entry's low / high
+  thresholds in ADC_vect. Only a change of zone (low / in range / high) is
+  queued, with the value and the time in trigger periods (ms at 1 kHz), so
+  the main loop has nothing to poll while readings are in range. A zone is
+  only left again once the value is 'hysteresis' back inside the threshold.
+*/
+#define ADC_SAMPLE_RATE_HZ  1000    // conversion takes 13 ADC clocks = 104 us, so < 9.6 kHz
+#define ADC_TIMER_PRESCALER 8
+#define ADC_TIMER_COUNTS    (F_CPU / ADC_TIMER_PRESCALER / ADC_SAMPLE_RATE_HZ)  // 2000
+#define ADC_BLOCK_SIZE      64      // samples per block (sum of squares fits 32 bits up to 4096)
+#define ADC_NO_BLOCK        0xFF
+// auto-triggered conversion: 13.5 ADC clocks (ADC clock = F_CPU / 128) from trigger to result
+#define ADC_CONVERSION_US   (27UL * 128UL * 1000UL / 2UL / (F_CPU / 1000UL))   // 108 us
+
+// MUX5:0 for the single-ended inputs, MUX5 is bit 3 of ADCSRB
+#define ADC_MUX(ch)         ((ch) < 8 ? (ch) : 0x20 + (ch) - 8) // ADC0-ADC15
+#define ADC_MUX_BANDGAP     0x1E    // internal 1.1 V (supply voltage = 1.1 V * 1024 / result)
+#define ADC_REF_AREF        0x00
+#define ADC_REF_AVCC        (1<<REFS0)
+#define ADC_REF_1V1         (1<<REFS1)
+#define ADC_REF_2V56        (1<<REFS1 | 1<<REFS0)
+#define ADC_RING_SIZE       8       // power of two
+#define ADC_RX_AWAKE_TICKS  20      // ADC_NOISE_REDUCTION: after an RXD0 edge, 2 bytes at 9600 baud
+#define ADC_RING_MASK       (ADC_RING_SIZE - 1)
+
+typedef struct
+{
+    unsigned char mux;              // ADC_MUX(n) or ADC_MUX_BANDGAP
+    unsigned char ref;              // ADC_REF_...
+    unsigned char decimation;       // converted every Nth pass (1 = every pass)
+    unsigned char discard_first;    // drop the first conversion after a switch to this entry
+    unsigned char oversample;       // n: 4^n conversions per result, 10 + n bits (0-4)
+} ADC_ScanEntry;
+
+// the channels on the board, first entry = block channel
+// (host/test_adc.c defines ADC_SCAN_TABLE to convert its own list)
+#ifdef ADC_SCAN_TABLE
+const ADC_ScanEntry adc_scan[] = ADC_SCAN_TABLE;
+#else
+const ADC_ScanEntry adc_scan[] =
+{
+    { ADC_MUX(0),      ADC_REF_AVCC, 1,   0, 0 },  // fast signal
+    { ADC_MUX(1),      ADC_REF_AVCC, 100, 1, 2 },  // thermistor, 12 bit
+    { ADC_MUX_BANDGAP, ADC_REF_AVCC, 100, 1, 0 },  // supply voltage
+    { ADC_MUX(2),      ADC_REF_AVCC, 10,  1, 1 },  // light level, 11 bit
+};
+#endif
+#define ADC_SCAN_COUNT      (sizeof(adc_scan) / sizeof(adc_scan[0]))
+
+// results, one ring per entry (written by ADC_vect)
+typedef struct
+{
+    volatile unsigned int ring[ADC_RING_SIZE];
+    volatile unsigned char head;
+    volatile unsigned int latest;
+    volatile unsigned int count;    // results stored
+    unsigned char countdown;        // passes until the next conversion (ISR only)
+    unsigned long acc;              // oversampling sum (ISR only)
+    unsigned int acc_count;         // conversions in acc
+} ADC_Result;
+
+ADC_Result adc_result[ADC_SCAN_COUNT];
+volatile unsigned char adc_current = 0; // entry being converted
+volatile unsigned long adc_time = 0;    // conversions (trigger periods) since start
+
+// analog watchdog, thresholds in the entry's result units (10 + oversample bits)
+#define ADC_ZONE_IN         0
+#define ADC_ZONE_LOW        1
+#define ADC_ZONE_HIGH       2
+#define ADC_EVENT_SIZE      8       // power of two
+#define ADC_EVENT_MASK      (ADC_EVENT_SIZE - 1)
+
+typedef struct
+{
+    unsigned int low, high;         // out of range below low / above high
+    unsigned int hysteresis;        // distance back inside before returning to ADC_ZONE_IN
+    unsigned char zone;             // current ADC_ZONE_... (ISR only)
+} ADC_Watch;
+
+// low = 0 and high = 0xFFFF: never fires
+ADC_Watch adc_watch[ADC_SCAN_COUNT] =
+{
+    { 0,   0xFFFF, 0,  ADC_ZONE_IN },   // fast signal: off
+    { 800, 3200,   40, ADC_ZONE_IN },   // thermistor (12 bit)
+    { 200, 250,    5,  ADC_ZONE_IN },   // bandgap: > 250 = supply below 4.5 V, < 200 = above 5.6 V
+    { 0,   0xFFFF, 0,  ADC_ZONE_IN },   // light level: off
+};
+
+typedef struct
+{
+    unsigned char entry;
+    unsigned char zone;             // zone entered
+    unsigned int value;
+    unsigned long time;             // adc_time of the result
+} ADC_Event;
+
+volatile ADC_Event adc_events[ADC_EVENT_SIZE];
+volatile unsigned char adc_event_head = 0, adc_event_tail = 0;
+volatile unsigned int adc_events_dropped = 0;
+volatile unsigned char adc_discard = 0; // next result is the settling conversion
+volatile unsigned char adc_tick = 0;    // ADC_NOISE_REDUCTION: time for the next conversion
+volatile unsigned char adc_rx_awake = 0; // ADC_NOISE_REDUCTION: trigger periods left without sleep (RX)
+
+volatile unsigned int adc_block[2][ADC_BLOCK_SIZE];
+volatile unsigned char adc_fill_block = 0;          // block the ISR is filling
+volatile unsigned char adc_fill_index = 0;
+volatile unsigned char adc_ready_block = ADC_NO_BLOCK; // full block for the main loop
+volatile unsigned int adc_block_overruns = 0;       // block finished before the last one was processed
+
+// statistics of the last processed block (10-bit ADC counts)
+typedef struct
+{
+    unsigned int min, max, mean, rms;
+} ADC_Stats;
+
+ADC_Stats adc_stats;
+volatile unsigned int analog_temp = 0; // mean of the last block
+unsigned char print_flag = 0; // set on 'p', printed by the main loop
+char hyperText[64];  // longest line: an ADC event (48 characters)
 
-void USART0_SETUP_9600_BAUD();
-void USART0_TX_SingleByte(unsigned char cByte);
-void USART0_TX_String(char* sData);
-void Start_ADC_Conversion(void);
 void init_timer1();
 void init_adc();
+void ADC_ProcessBlock(volatile unsigned int* pBlock, ADC_Stats* pStats);
+void ADC_SelectEntry(unsigned char entry);
+unsigned int ADC_Latest(unsigned char entry);
+void ADC_ConvertAsleep();
+void ADC_SetThresholds(unsigned char entry, unsigned int low, unsigned int high, unsigned int hysteresis);
+unsigned char ADC_GetEvent(ADC_Event* pEvent);
+unsigned int isqrt32(unsigned long x);
 
 
 int main()
 {
+    unsigned char block;
+    ADC_Event event;
+    int command;
+    char* p;
+
     DDRH = (1<<PH4 | 1<<PH3);
     PORTH = 0x00;
     init_adc();
     init_timer1();
     USART0_SETUP_9600_BAUD();
+    // clocks of the peripherals this firmware does not use
+    POWER_Init((1<<PRTWI | 1<<PRTIM2 | 1<<PRTIM0 | 1<<PRSPI),
+               (1<<PRTIM5 | 1<<PRTIM4 | 1<<PRTIM3 | 1<<PRUSART3 | 1<<PRUSART2 | 1<<PRUSART1));
+    PROFILER_Init(); // Timer3 clock on again while profiling
     asm("sei");
 
-    // Start the ADC Conversion (start first sample, runs in 'free run' mode after)
-    //  bit 6 ADSC (ADC Start Conversion) = 1 (START)
-    //  Read ADSCSR and OR with this value to set the flag without changing others
-    
-    ADCSRA |= 1<<ADSC; 
+    // conversions are started by Timer1, nothing to start here
     while(1)
     {
-        /* if (sample_flag == 1) { */
+#ifdef ADC_NOISE_REDUCTION
+        if (adc_tick)
+        {
+            adc_tick = 0;
+            ADC_ConvertAsleep();
+        }
+#endif
+        block = adc_ready_block;
+        if (block != ADC_NO_BLOCK)
+        {
+            ADC_ProcessBlock(adc_block[block], &adc_stats);
+            analog_temp = adc_stats.mean;
+            cli();
+            if (adc_ready_block == block) {
+                adc_ready_block = ADC_NO_BLOCK; // done, unless the ISR has already handed over the next one
+            }
+            sei();
+        }
+        while (ADC_GetEvent(&event))
+        {
+            // e.g. act on an over-temperature or low supply here
+            p = FMT_Text(hyperText, "ADC event ");
+            p = FMT_Text(FMT_Uint(p, event.entry), ": zone ");
+            p = FMT_Text(FMT_Uint(p, event.zone), " value ");
+            p = FMT_Text(FMT_Uint(p, event.value), " t ");
+            FMT_Ulong(p, event.time);
+            USART0_TX_String(hyperText);
+        }
+        while ((command = USART0_RX_Byte()) >= 0)
+        {
+            if (command == 'p') {
+                print_flag = 1;
+            }
+            else if (command == 'q') {
+                USART0_TX_String("\n q \r\n");
+            }
+#ifdef PROFILER
+            else if (command == 'i') // ISR run time / entry latency
+            {
+                usart0_tx_policy = USART0_TX_BLOCK; // longer than the TX buffer
+                PROFILER_Print(USART0_TX_String);
+                usart0_tx_policy = USART0_TX_FULL_POLICY;
+            }
+            else if (command == 'c') {
+                PROFILER_Reset();
+            }
+#endif
+        }
+        if (print_flag)
+        {
+            print_flag = 0;
+            USART0_TX_String("\nTemp min / max / mean / rms: ");
+            p = FMT_Uint(hyperText, adc_stats.min);
+            *p++ = ' ';
+            p = FMT_Uint(p, adc_stats.max);
+            *p++ = ' ';
+            p = FMT_Uint(p, adc_stats.mean);
+            *p++ = ' ';
+            FMT_Uint(p, adc_stats.rms);
+            USART0_TX_String(hyperText);
+            USART0_TX_String("Entry: latest / conversions");
+            for (unsigned char i = 0; i < ADC_SCAN_COUNT; i++)
+            {
+                p = FMT_Text(FMT_Uint(hyperText, i), ": ");
+                p = FMT_Uint(p, ADC_Latest(i));
+                *p++ = ' ';
+                FMT_Uint(p, adc_result[i].count);
+                USART0_TX_String(hyperText);
+            }
+            USART0_TX_String("Mode: sleeps / max wake us (idle, adc, save, down)");
+            for (unsigned char i = 0; i < POWER_MODES; i++)
+            {
+                p = FMT_Text(FMT_Uint(hyperText, i), ": ");
+                p = FMT_Uint(p, power_sleeps[i]);
+                *p++ = ' ';
+                FMT_Uint(p, power_wake_us_max[i]);
+                USART0_TX_String(hyperText);
+            }
+        }
+
+        // everything arrives by interrupt: sleep until the next one
+        cli();
+        if (adc_ready_block == ADC_NO_BLOCK && !adc_tick
+            && adc_event_head == adc_event_tail && usart0_rx_head == usart0_rx_tail) {
+            POWER_Sleep();
+        }
+        sei();
+    }
+}
+
+// min / max / mean / RMS of one block, no per-sample work in the ISR
+void ADC_ProcessBlock(volatile unsigned int* pBlock, ADC_Stats* pStats)
+{
+    unsigned int sample, min = 0xFFFF, max = 0;
+    unsigned long sum = 0, sum_sq = 0;
+
+    for (unsigned char i = 0; i < ADC_BLOCK_SIZE; i++)
+    {
+        sample = pBlock[i];
+        if (sample < min) min = sample;
+        if (sample > max) max = sample;
+        sum += sample;
+        sum_sq += (unsigned long)sample * sample;
+    }
+    pStats->min = min;
+    pStats->max = max;
+    pStats->mean = (sum + ADC_BLOCK_SIZE / 2) / ADC_BLOCK_SIZE;   // power of two: a shift
+    pStats->rms = isqrt32(sum_sq / ADC_BLOCK_SIZE);
+}
+
+void ADC_SetThresholds(unsigned char entry, unsigned int low, unsigned int high, unsigned int hysteresis)
+{
+    unsigned char sreg = SREG;
+
+    cli();
+    adc_watch[entry].low = low;
+    adc_watch[entry].high = high;
+    adc_watch[entry].hysteresis = hysteresis;
+    adc_watch[entry].zone = ADC_ZONE_IN; // re-evaluated on the next result
+    SREG = sreg;
+}
+
+// Copy the oldest watchdog event, returns 0 if there is none
+unsigned char ADC_GetEvent(ADC_Event* pEvent)
+{
+    if (adc_event_tail == adc_event_head) {
+        return 0;
+    }
+    pEvent->entry = adc_events[adc_event_tail].entry;
+    pEvent->zone = adc_events[adc_event_tail].zone;
+    pEvent->value = adc_events[adc_event_tail].value;
+    pEvent->time = adc_events[adc_event_tail].time;
+    adc_event_tail = (adc_event_tail + 1) & ADC_EVENT_MASK;
+    return 1;
+}
+
+// Start one conversion in ADC Noise Reduction sleep, ADC_vect wakes the CPU again
+void ADC_ConvertAsleep()
+{
+    if (adc_rx_awake)
+    {
+        adc_rx_awake--;
+        ADCSRA |= (1<<ADSC); // receiving: the USART clock must keep running
+        return;
+    }
+    if (usart0_tx_active)
+    {
+        if (usart0_tx_head != usart0_tx_tail || !(UCSR0A & (1<<TXC0)))
+        {
+            ADCSRA |= (1<<ADSC); // USART0 is sending: its clock must keep running
+            return;
+        }
+        usart0_tx_active = 0; // last stop bit is out
+    }
+    set_sleep_mode(SLEEP_MODE_ADC);
+    cli();
+    sleep_enable();
+    sei();
+    sleep_cpu(); // entering the sleep mode starts the conversion
+    sleep_disable();
+}
 
-        /*     T = (float)analog_temp / THERMISTORNOMINAL;  */
-        /*     TCNT1H = 0x00; */
-        /*     TCNT1L = 0x00;  */
-        /*     sample_flag = 0; */
-        /* }    */
+// Integer square root (bit by bit, no floating point)
+unsigned int isqrt32(unsigned long x)
+{
+    unsigned long root = 0, bit = 1UL << 30;
+    while (bit > x) {
+        bit >>= 2;
     }
+    while (bit != 0)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (unsigned int)root;
 }
 
 
 void init_adc ()
 {
     // ADC Multiplexer Selection Register
-    ADMUX = (1<<REFS0 | 1<< ADLAR ); // AVCC with external capacitor at AREF pin,  ADC0 = PF0
+    ADMUX = (1<<REFS0); // AVCC with external capacitor at AREF pin,  ADC0 = PF0, right adjusted (10 bit)
 
     // ADLAR: ADC Left Adjust Result
     //  0 = ADCH (high) contains bit 1 = output bit 9, bit 0 = output bit 8
@@ -62,104 +415,206 @@ void init_adc ()
     // see datasheet p. 286
 
     
-    ADCSRA = (1<<ADEN | 1<<ADIE | 1<<ADPS2 | 1<<ADPS1 | 1<<ADPS0);
-    // ADC Enable, start conversion, auto trigger, division factor = 128.
+#ifdef ADC_NOISE_REDUCTION
+    ADCSRA = (1<<ADEN | 1<<ADIE | 1<<ADPS2 | 1<<ADPS1 | 1<<ADPS0); // started by ADC_ConvertAsleep()
+#else
+    ADCSRA = (1<<ADEN | 1<<ADATE | 1<<ADIE | 1<<ADPS2 | 1<<ADPS1 | 1<<ADPS0);
+#endif
+    // ADC Enable, auto trigger, interrupt, division factor = 128.
     // we have  a 16 MHz clk, the ADC requires a clk freq. in the range [50, 200] kHz.
     // -> 16M/200k = 80, the next highest division factor is 128.
     
    
-    // When this bit is written to one, Auto Triggering of the ADC is enabled. The ADC will start a conversion on a positive edge of the selected trigger signal. 
-    ADCSRB = 0x00;
+    // ADATE: when this bit is written to one, Auto Triggering of the ADC is enabled. The ADC will start a conversion on a positive edge of the selected trigger signal. 
+    // ADTS2:0 = 101: Timer/Counter1 Compare Match B
+    ADCSRB = (1<<ADTS2 | 1<<ADTS0);
 
     // Digital Input Disable Register 
-    DIDR0 = (1<<ADC0D); // disable digital input on the pin used for analog readings.
+    DIDR0 = 0x00;
     DIDR1 = 0x00;
+    DIDR2 = 0x00;
+    for (unsigned char i = 0; i < ADC_SCAN_COUNT; i++)
+    {
+        // disable digital input on the pins used for analog readings.
+        if (adc_scan[i].mux < 8) {
+            DIDR0 |= 1<<adc_scan[i].mux;            // ADC0D-ADC7D
+        }
+        else if (adc_scan[i].mux >= 0x20 && adc_scan[i].mux < 0x28) {
+            DIDR2 |= 1<<(adc_scan[i].mux - 0x20);   // ADC8D-ADC15D
+        }
+        adc_result[i].countdown = 1; // every entry is due on the first pass
+    }
+    adc_current = 0;
+    ADC_SelectEntry(0);
+    adc_discard = adc_scan[0].discard_first;
 }
 
-ISR(ADC_vect)
+// ADMUX / MUX5 for an entry (in ADC_vect: before the trigger flag is cleared)
+void ADC_SelectEntry(unsigned char entry)
+{
+    ADMUX = adc_scan[entry].ref | (adc_scan[entry].mux & 0x1F);
+    if (adc_scan[entry].mux & 0x20) {
+        ADCSRB |= (1<<MUX5);
+    }
+    else {
+        ADCSRB &= ~(1<<MUX5);
+    }
+}
+
+// Newest result of an entry
+unsigned int ADC_Latest(unsigned char entry)
 {
-    // analog_temp = ADCL; // right shift
-    analog_temp = ADCH;
-    sprintf(hyperText, "%d", analog_temp);
+    unsigned int value;
+    unsigned char sreg = SREG;
 
-    ADCSRA |= 1<<ADSC;
+    cli(); // 16-bit read must not be split by ADC_vect
+    value = adc_result[entry].latest;
+    SREG = sreg;
+    return value;
 }
 
- 
- ISR(USART0_RX_vect) // USART Receive-Complete Interrupt Handler
+ISR(ADC_vect)
 {
-    char cData = UDR0;
-    if (cData == 'p')
+#ifdef ADC_NOISE_REDUCTION
+    PROFILER_ENTER(PROFILER_ADC, PROFILER_NO_WAIT); // started from the main loop
+#else
+    // Timer1 restarted from 0 at the trigger: cycles since then, less the conversion
+    PROFILER_ENTER(PROFILER_ADC, PROFILER_SINCE(TCNT1 * ADC_TIMER_PRESCALER,
+                                                ADC_CONVERSION_US * (F_CPU / 1000000UL), 1));
+#endif
+    unsigned int sample = ADC; // ADCL then ADCH, 10 bit
+    unsigned char entry = adc_current, next, block;
+    ADC_Result* pResult = &adc_result[entry];
+    ADC_Watch* pWatch = &adc_watch[entry];
+    unsigned char zone;
+
+    adc_time++;
+#ifndef ADC_NOISE_REDUCTION
+    // Timer1 restarted from 0 at the trigger: the time in excess of the conversion is the wake / response time
+    if (TCNT1 / (F_CPU / ADC_TIMER_PRESCALER / 1000000UL) > ADC_CONVERSION_US) {
+        POWER_WAKE_SAMPLE(TCNT1 / (F_CPU / ADC_TIMER_PRESCALER / 1000000UL) - ADC_CONVERSION_US);
+    }
+#endif
+    if (adc_discard)
     {
-        USART0_TX_String("\nTemp: \r\n");
-        USART0_TX_String(hyperText);
+        adc_discard = 0; // settling conversion, the next one is kept
+        TIFR1 = (1<<OCF1B);
+        return;
     }
-    else if (cData == 'q')
+    if (adc_scan[entry].oversample)
     {
-        USART0_TX_String("\n q \r\n");
+        pResult->acc += sample;
+        if (++pResult->acc_count < (1U << (2 * adc_scan[entry].oversample)))
+        {
+            TIFR1 = (1<<OCF1B); // stay on this entry for the rest of the 4^n conversions
+            return;
+        }
+        sample = pResult->acc >> adc_scan[entry].oversample;
+        pResult->acc = 0;
+        pResult->acc_count = 0;
     }
-}
+    pResult->ring[pResult->head] = sample;
+    pResult->head = (pResult->head + 1) & ADC_RING_MASK;
+    pResult->latest = sample;
+    pResult->count++;
 
-// screen /dev/cu.usbserial 9600
-// press Ctrl+a, type :quit and press Enter. 
-
-void USART0_SETUP_9600_BAUD()
-{
-    // USART Control and Status Register A
-    UCSR0A = (1<<U2X0); // Double the USART Transmission Speed
-    // Writing this bit to one will reduce the divisor of the baud rate divider from 16 to 8 effectively doubling the transfer
-    //rate for asynchronous communication.
+    // analog watchdog: queue zone changes only
+    zone = pWatch->zone;
+    if (sample > pWatch->high) {
+        zone = ADC_ZONE_HIGH;
+    }
+    else if (sample < pWatch->low) {
+        zone = ADC_ZONE_LOW;
+    }
+    else if ((zone == ADC_ZONE_HIGH && sample + pWatch->hysteresis <= pWatch->high)
+             || (zone == ADC_ZONE_LOW && sample >= pWatch->low + pWatch->hysteresis)) {
+        zone = ADC_ZONE_IN;
+    }
+    if (zone != pWatch->zone)
+    {
+        pWatch->zone = zone;
+        next = (adc_event_head + 1) & ADC_EVENT_MASK;
+        if (next == adc_event_tail) {
+            adc_events_dropped++;
+        }
+        else
+        {
+            adc_events[adc_event_head].entry = entry;
+            adc_events[adc_event_head].zone = zone;
+            adc_events[adc_event_head].value = sample;
+            adc_events[adc_event_head].time = adc_time;
+            adc_event_head = next;
+        }
+    }
 
-    // USART Control and Status Register B
-    /* RX Complete Interrupt Enable, RX Enable, TX Enable, 8-bit data */
-    UCSR0B = (1<<RXCIE0 | 1<<RXEN0 | 1<<TXEN0);
-    
-    // USART Control and Status Register C
-    /* Asynchronous, No Parity, 1 stop, 8-bit data, Falling XCK edge */
-    UCSR0C = (1<<UCSZ01 | 1<<UCSZ00 | 1<<UCPOL0);
-  
-    // UBRR0 - USART Baud Rate Register (16-bit register, comprising UBRR0H and UBRR0L)
-    UBRR0H = 0; // 9600 baud, UBRR = 12, and  U2X must be set to '1' in UCSRA
-    UBRR0L = 207;
-    // see datasheet p. 225, f_osc = 16 MHz
-}
+    if (entry == 0)
+    {
+        block = adc_fill_block;
+        adc_block[block][adc_fill_index] = sample;
+        if (++adc_fill_index == ADC_BLOCK_SIZE)
+        {
+            adc_fill_index = 0;
+            if (adc_ready_block != ADC_NO_BLOCK) {
+                adc_block_overruns++; // main loop too slow, the old block is replaced
+            }
+            adc_ready_block = block;
+            adc_fill_block = block ^ 1;
+        }
+    }
 
-void USART0_TX_SingleByte(unsigned char cByte)
-{
-    while( !(UCSR0A & (1 << UDRE0)) ); // Wait for Tx Buffer to become empty (check UDRE flag)
-    UDR0 = cByte;   // Writing to the UDR transmit buffer causes the byte to be transmitted
-}
+    // next entry that is due (an entry with decimation 1 ends the search within one pass)
+    next = entry;
+    do
+    {
+        if (++next == ADC_SCAN_COUNT) {
+            next = 0;
+        }
+    } while (--adc_result[next].countdown != 0);
+    adc_result[next].countdown = adc_scan[next].decimation;
 
-void USART0_TX_String(char* sData)
-{
-    int iCount;
-    int iStrlen = strlen(sData);
-    if(0 != iStrlen)
+    if (next != entry)
     {
-        for(iCount = 0; iCount < iStrlen; iCount++)
-        {
-            USART0_TX_SingleByte(sData[iCount]);
+        ADC_SelectEntry(next); // the next conversion starts on the next trigger
+        adc_current = next;
+        if (adc_scan[next].discard_first
+            && (adc_scan[next].mux != adc_scan[entry].mux || adc_scan[next].ref != adc_scan[entry].ref)) {
+            adc_discard = 1;
         }
-        USART0_TX_SingleByte(CR);
-        USART0_TX_SingleByte(LF);
     }
+    TIFR1 = (1<<OCF1B); // the trigger is the flag's rising edge: clear it for the next sample
 }
 
-
+ 
+// ADC sample clock: Compare Match B once per period starts a conversion (no interrupt needed)
 void init_timer1()
 {
     TCCR1A = 0x00;  // Normal port operation (OC1A, OC1B, OC1C), Clear Timer on 'Compare Match' (CTC) waveform mode)
-    TCCR1B = (1<<WGM12 | 1<<CS12 | 1<<CS10);  // CTC waveform mode, initially stopped (no clock), prescaler = 1024
-    // For 1 sec we need to count to ( (1 sec * 16 000 000 Hz) / 1024) = 0x3D09
-    OCR1AH = 0x3D; // Output Compare Registers (16 bit)
-    OCR1AL = 0x09;
-
-    TCNT1H = 0x00;  // Timer/Counter count/value registers (16 bit)
-    TCNT1L = 0x00;
-    TIMSK1 = (1<<OCIE1A);  // generate an interrupt when the timer reaches the set value in the OCR1A register
+    TCCR1B = (1<<WGM12 | 1<<CS11);  // CTC waveform mode, TOP = OCR1A, prescaler = 8
+    // 1 kHz: (16 000 000 Hz / 8) / 1000 = 2000 counts
+    OCR1A = ADC_TIMER_COUNTS - 1;   // Output Compare Registers (16 bit)
+    OCR1B = ADC_TIMER_COUNTS - 1;   // match B at TOP as well: the ADC trigger
+
+    TCNT1 = 0x0000;  // Timer/Counter count/value registers (16 bit)
+#ifdef ADC_NOISE_REDUCTION
+    TIMSK1 = (1<<OCIE1B); // TIMER1_COMPB_vect paces the main loop's sleep conversions
+    PCMSK1 |= (1<<PCINT8); // RXD0 (PE0): keeps the USART clock running while a line arrives
+    PCICR |= (1<<PCIE1);
+#else
+    TIMSK1 = 0x00;   // the OCF1B flag triggers the ADC, it is cleared in ADC_vect
+#endif
+}
+
+#ifdef ADC_NOISE_REDUCTION
+// Edge on RXD0: wakes the CPU at a start bit, no sleep until the line is quiet
+ISR(PCINT1_vect)
+{
+    adc_rx_awake = ADC_RX_AWAKE_TICKS;
 }
 
-ISR(TIMER1_COMPA_vect)
+ISR(TIMER1_COMPB_vect)
 {
-    sample_flag = 1;  
+    PROFILER_ENTER(PROFILER_TIMER1_COMPB, TCNT1 * ADC_TIMER_PRESCALER);
+    POWER_WAKE_SAMPLE(TCNT1 / (F_CPU / ADC_TIMER_PRESCALER / 1000000UL)); // counts since the match
+    adc_tick = 1;
 }
+#endif
@@ -24,29 +24,11 @@
    Buzzer  <->  PK4
 */
 
-/*
-  - - - - - - - - - - - - - - - - -
-  Ultrasonic sensor HC-SR04
-  Datasheet: 
-  https://cdn.sparkfun.com/datasheets/Sensors/Proximity/HCSR04.pdf
-  Range: 2 cm - 400 cm
-  Accuracy: ~3 mm
-  Ultrasonic sensor HC-SR04 <-> Arduino Mega (Connection)
-  - - - - - - - - - - - - - - - - -
-  VCC    <-> 5V
-  GND    <-> GND
-  ECHO   <-> PL0 (ICP4)
-  TRIG   <-> PL1
-  - - - - - - - - - - - - - - - - -
-*/
-
-
 // AVR libraries
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
 // C libs
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -55,10 +37,33 @@
 
 #include <util/delay.h>
 
-// header files
-#include "LCD_Lib_2560.h"
-#include "keypad.h"
-#include "usart_2560.h"
+// 32-bit time base (1 us ticks = CPU cycles) on the first 16-bit timer the sonar array does not use,
+// shared by the sonar time stamps, the scheduler and the ISR profiler (make EXTRA_CFLAGS=-DPROFILER).
+// With 4 sensors there is none: the sonar and scheduler use the 1 ms tick, the profiler is not available.
+#if !defined(SONAR_SENSORS) || SONAR_SENSORS < 2
+#define TIMEBASE_TIMER  5
+#elif SONAR_SENSORS < 3
+#define TIMEBASE_TIMER  3
+#elif SONAR_SENSORS < 4
+#define TIMEBASE_TIMER  1
+#endif
+#ifdef TIMEBASE_TIMER
+#define TIMEBASE_PRESCALER  1
+#define PROFILER_TIMER      TIMEBASE_TIMER
+#endif
+
+// header files (drivers shared with the other firmwares are in common/)
+#include "../../common/LCD_Lib_2560.h"
+#include "../../common/LCD_FrameBuffer_2560.h"
+#include "../../common/keypad.h"
+#include "../../common/usart_2560.h"
+#include "../../common/power_2560.h"
+#ifdef TIMEBASE_TIMER
+#include "../../common/timebase_2560.h"
+#endif
+#include "../../common/scheduler.h"
+#include "../../common/format.h"
+#include "sonar.h"
 
 #define TopRow       0
 #define BottomRow    1
@@ -66,15 +71,44 @@
 #define G_LED        PK1
 #define B_LED        PK2
 #define BUZZER       PK4
-#define TRIGpin      PINL1
+
+// task periods (ms)
+#define SERIAL_PERIOD       10
+#define SONAR_PERIOD        10
+#define KEYPAD_PERIOD       20
+#define ALARM_PERIOD        20
+#define INDICATOR_PERIOD    50
+#define DISPLAY_PERIOD      100
+
+// detection zone (cm) and sonar range gate
+#define ZONE_MIN_CM         5
+#define ZONE_MAX_CM         35
+#define SONAR_GATE_CM       50  // a bit past the zone so the median filter sees its edge
+
+// buzzer / red LED pattern while the alarm is active
+#define ALARM_ON_MS         750
+#define ALARM_OFF_MS        700
+
+// timeouts (ms), counted from alarm_timer_start / disarm_start
+#define INTRUDER_MS         20000   // alarm stays on
+#define PASSCODE_MS         30000   // time to enter the passcode
+#define DISARM_MS           60000   // re-arm after 1 minute
+
+// what display_task is showing
+enum SCREEN { SCREEN_OFF, SCREEN_DISARMED, SCREEN_ALARM, SCREEN_ENTER_CODE, SCREEN_DIGITS };
 
 // - Function declarations
 void InitialiseGeneral();
-void init_timer1();
-void init_timer3();
-void init_timer4();
-void init_timer5();
 void pressing_keypad(unsigned char KeyValue);
+void serial_command(char* sLine);
+
+// - Tasks (run by the scheduler, must not block)
+void serial_task();
+void sonar_task();
+void keypad_task();
+void alarm_task();
+void indicator_task();
+void display_task();
 
 /*
   A volatile modifier is used when we want to prevent 
@@ -83,13 +117,11 @@ void pressing_keypad(unsigned char KeyValue);
   We declare data types as volatile if they are global or gets interrupted by a timer.
 */
 
-// vars for ultrasonic sensor
-volatile int16_t counts, dist, rising, falling, us_per_count;
+// vars for intrusion detection
 volatile unsigned char set_intruder_flag = 0;
 
 // vars for USART
-volatile unsigned char textToWrite[16];
-volatile unsigned char hyperText[16];
+char commandLine[16];
 
 // vars for keypad and passcode
 volatile unsigned char passcode[8] = {1,2,3,4};
@@ -98,359 +130,440 @@ volatile unsigned char first_digit, second_digit, third_digit, fourth_digit;
 volatile unsigned char set_disarm_flag, set_passcode_flag = 0;
 volatile unsigned char new_passcode_flag = 0;
 
-// used for testing
-volatile unsigned char ElapsedSeconds_Count = 0;
+// SCHED_Millis() when the intruder / passcode timeout and the disarm timeout started
+unsigned int alarm_timer_start = 0;
+unsigned int disarm_start = 0;
+
+unsigned char display_task_id; // triggered when the screen must change right away
 
 // - - - - - - - - - - - - - - - - -
 int main()
 {
-    unsigned char KeyValue;
     InitialiseGeneral();
-    LCD_Home();
-    init_timer1();
-    init_timer3();
-    init_timer4();
-    init_timer5();
+    LCD_FB_Init();
+    LCD_StartAsync(); // from here on LCD writes are queued and sent by LCD_Service()
+    SONAR_Init();
+    SONAR_SetMaxRange(SONAR_GATE_CM);
+    SONAR_SetAdaptive(true);
     USART0_SETUP_9600_BAUD();
+    // the prompt is longer than the buffer, wait for room instead of dropping it
+    usart0_tx_policy = USART0_TX_BLOCK;
+    USART0_TX_String("(P) enter new passcode on keypad / (D) distance / (Q) quit:\r\n");
+    USART0_TX_String("(CODE nnnn) set passcode / (STAT) serial errors / (TASKS) task run times / (LCD) LCD bus writes / (SONAR) ping rate / (POWER) sleep stats,\r\nend each command with Enter\r\n");
+#ifdef PROFILER
+    USART0_TX_String("(ISR) ISR run / wait cycles / (ISR CLEAR) reset them\r\n");
+#endif
+    usart0_tx_policy = USART0_TX_FULL_POLICY;
+
+    // clocks of the peripherals this firmware does not use
+    POWER_Init((1<<PRTWI | 1<<PRSPI | 1<<PRADC | (SONAR_SENSORS < 4 ? 1<<PRTIM1 : 0)),
+               (1<<PRUSART1 | 1<<PRUSART2 | 1<<PRUSART3
+                | (SONAR_SENSORS < 3 ? 1<<PRTIM3 : 0) | (SONAR_SENSORS < 2 ? 1<<PRTIM5 : 0)));
+#ifdef TIMEBASE_TIMER
+    TIMEBASE_Init(); // clock of TIMEBASE_TIMER on again
+#endif
+    PROFILER_Init();
+
+    SCHED_Init();
+    SCHED_AddTask(serial_task, SERIAL_PERIOD);
+    SCHED_AddTask(sonar_task, SONAR_PERIOD);
+    SCHED_AddTask(keypad_task, KEYPAD_PERIOD);
+    SCHED_AddTask(alarm_task, ALARM_PERIOD);
+    SCHED_AddTask(indicator_task, INDICATOR_PERIOD);
+    display_task_id = SCHED_AddTask(display_task, DISPLAY_PERIOD);
 
     while(1)
     {
-        KeyValue = ScanKeypad();
-        // user is setting a new passcode
-        if (new_passcode_flag == 1 && set_passcode_flag == 1)
-        {
-            for (int i=0; i<4; i++)
-            {
-                USART0_TX_SingleByte(passcode[i]+48);   // print current passcode
-                _delay_ms(250);
-            }
-            USART0_TX_String("\n");
-        }
-        // pressing keypad
-        if (NoKey != KeyValue)
-        {
-            pressing_keypad(KeyValue);
-        }
-        // correct passcode
-        else if (first_digit == passcode[0]
-                 && second_digit == passcode[1]
-                 && third_digit  == passcode[2]
-                 && fourth_digit == passcode[3]
-                 && KeyPresses != 0)
-        {
-            TCNT5H = 0x00;  // start 1 min counter
-            TCNT5L = 0x00;
-            // testing
-            // TCNT1H = 0x00; 
-            // TCNT1L = 0x00;
-            set_disarm_flag = 1; // disarm system
-            set_passcode_flag = 0;
-        }
-        // stay disarmed for 1 minute
-        while (set_disarm_flag == 1)
-        {
-            PORTK = (1<<G_LED); // green LED on
-            LCD_Display_ON_OFF(true, false, false);
-            LCD_Clear();
-            LCD_WriteString("DISARMED");
-            _delay_ms(1000);
-            KeyPresses = 0;
-            set_passcode_flag = 0;
-        }
-        // while system is armed: detect movement in the range [5 cm, 35 cm]
-        if (dist > 4 && dist < 36 && set_disarm_flag == 0 && set_intruder_flag == 0)
-        {
-            TCNT3H = 0x00;
-            TCNT3L = 0x00;
-            set_intruder_flag = 1;
-        }
-        // activate alarm
-        if (set_intruder_flag == 1 && set_passcode_flag == 0)
-        {
-            PORTK = (1<<R_LED | 1<<BUZZER); // red LED, buzzer active
-            LCD_Display_ON_OFF(true, false, false);
-            LCD_Clear();
-            LCD_SetCursorPosition(0, TopRow);
-            LCD_WriteString("OBJECT");
-            LCD_SetCursorPosition(0, BottomRow);
-            LCD_WriteString("DETECTED");
-            _delay_ms(750);
-        }
-        // standby
-        if (KeyPresses == 0)
-        {
-            first_digit = second_digit = third_digit = fourth_digit = 0;
-            PORTK = 0x00; // no alarm
-            _delay_ms(700);
-            LCD_Display_ON_OFF(false, false, false);
+        SCHED_Run();
+        LCD_Service(); // idle hook
+
+        // nothing left until the next interrupt (at the latest the 1 ms tick): sleep
+        cli();
+        if (!SCHED_Pending() && LCD_QueueDepth() == 0 && usart0_rx_head == usart0_rx_tail) {
+            POWER_Sleep();
         }
+        sei();
     }
 }
 
-void InitialiseGeneral()
-{   
-    /*  RGB-LED + buzzer  */
-    DDRK |=  (1<<BUZZER | 1<<B_LED | 1<<G_LED | 1<<R_LED); // Configure PortK direction for Output
-    PORTK &= ~(1<<BUZZER | 1<<B_LED | 1<<G_LED | 1<<R_LED); // Set all LEDs + buzzer initially off
-
-    /*  SONAR */
-    DDRL |= (1<<TRIGpin); // set TRIGPIN as output
-    PORTL &= ~(1<<TRIGpin); // set low
-
-    /*  KeyPad  */
-    DDRC = 0xF0; // Row pins output / Column pins input
-    PORTC = 0x0F; // Set pull-ups on column pins (so they read '1' when no key is pressed)
-
-    /*  LCD */
-    LCD_Initilise(true, false);
-    LCD_ShiftDisplay(false, true);
-    LCD_Display_ON_OFF(true, false, false);
-    // Display a fixed message on the top and bottom row of the LCD
-    LCD_Clear();
-    LCD_Home();
-    LCD_SetCursorPosition(0, TopRow);
-    LCD_WriteString("CWK-ESP5200");
-    LCD_SetCursorPosition(0, BottomRow);
-    LCD_WriteString("Victor Hansen");
-    _delay_ms(5000);
-    
-    asm ("sei"); // Enable interrupts
-}
-
-// used for testing
-// generate an interrupt after a 1-Second interval
-void init_timer1()
+// serial commands are parsed here, USART0_RX_vect only buffers the bytes
+void serial_task()
 {
-    TCCR1A = 0x00;  // Normal port operation (OC1A, OC1B, OC1C), Clear Timer on 'Compare Match' (CTC) waveform mode)
-    TCCR1B = (1<<WGM12 | 1<<CS12 | 1<<CS10);  // CTC waveform mode, initially stopped (no clock), prescaler = 1024
-    
-    // 1 MHz clock w/ 1024 prescaler
-    // For 1 sec we need to count to ( (1 sec * 1000000 MHz) / 1024) = 0x03D0
-    OCR1AH = 0x03; // Output Compare Registers (16 bit)
-    OCR1AL = 0xD0;
-
-    TCNT1H = 0x00;  // Timer/Counter count/value registers (16 bit)
-    TCNT1L = 0x00;
-    TIMSK1 = (1<<OCIE1A);  // generate an interrupt when the timer reaches the set value in the OCR1A register
+    if (USART0_RX_GetLine(commandLine, sizeof(commandLine)))
+    {
+        serial_command(commandLine);
+    }
 }
 
-// used for testing (1 s counter)
-ISR(TIMER1_COMPA_vect) // TIMER1_CompareA_Handler (Interrupt Handler for Timer 1)
+// convert and filter the echo times queued by the sonar capture ISRs
+void sonar_task()
 {
-    ElapsedSeconds_Count++;
-    if (set_disarm_flag == 0) {ElapsedSeconds_Count =0;}
-    sprintf(hyperText, "%d", ElapsedSeconds_Count);
-//    USART0_TX_String("\r\n");
-//    USART0_TX_String(hyperText);
+    SONAR_Process();
 }
 
-/*  Ultrasonic Sensor  */
-void init_timer4()
+// handle the key events queued by the keypad scan ISR (debounced there)
+void keypad_task()
 {
-    TCCR4A = (1<<WGM41); // Clear OCnA/OCnB/OCnC on compare match (set output to low level)
-    TIMSK4 = (1<<OCIE4A | 1<<ICIE4);
-    
-    // Input Capture Noise Canceler / Input capture on rising edge / prescaler 8
-    TCCR4B = (1<<ICNC4 | 1<<ICES4 | 1<<CS41);
-    
-    /*  ICESn selects which edge on the Input Capture pin (ICPn) that is used to trigger a capture event.
-        ICESn bit = 0 --> a falling edge is used as trigger.
-        ICESn bit = 1 --> a rising edge will trigger the capture.
-        When a capture is triggered, the counter value is copied into the Input Capture Register (ICRn).
-    */
-    
-    /*
-      The datasheet for HCSR04 suggest to use over 60 ms measurement cycle.
-      70ms measurement cycle: 1MHz/8 = 125k counts/sec -> 12,5k counts/100ms 
-      -> 12500/100*70 = 8750 counts per 70ms
-    */
-    
-    OCR4AH = 0x22;
-    OCR4AL = 0x2e;
-    us_per_count = 8; /* (1MHz / 8) = 125,000 counts per second 
-                         -> 125,000/1,000,000 counts per usec = 1/8 counts per us
-                         -> 8 us per count */ 
+    unsigned char Event;
+
+    while ((Event = KEYPAD_GetEvent()) != NoKey)
+    {
+        if (set_disarm_flag == 1) {
+            continue; // keypad is ignored while the system is disarmed
+        }
+        if (!(Event & KEYPAD_RELEASE)) {
+            pressing_keypad(Event & KEYPAD_KEY_MASK);
+        }
+    }
 }
 
-ISR (TIMER4_CAPT_vect)
+// passcode check, intrusion detection and the alarm / disarm timeouts
+void alarm_task()
 {
-    /*  Rising edge (signal on the ICP pin goes from 0 -> 1): 
-        switch ICP to falling edge detection and then store the 'start-time'.
-       
-        Falling edge (1 -> 0): switch ICP to rising edge detection and get the 'end-time' to 
-        calculate the distance in cm.
-    */
-    if (TCCR4B & (1<<ICES4)) // Rising edge
+    unsigned int now = SCHED_Millis();
+
+    // correct passcode
+    if (set_disarm_flag == 0
+        && first_digit == passcode[0]
+        && second_digit == passcode[1]
+        && third_digit  == passcode[2]
+        && fourth_digit == passcode[3]
+        && KeyPresses != 0)
     {
-        TCCR4B &= ~(1<<ICES4); // Next time detect falling edge (ICESn = 0)
-        rising = ICR4; // Save current count (start-time)
+        disarm_start = now;  // start 1 min counter
+        set_disarm_flag = 1; // disarm system, re-armed after 1 minute
+        set_passcode_flag = 0;
+        KeyPresses = 0;
+    }
+    // while system is armed: detect movement in the range [5 cm, 35 cm] on any sensor
+    if (SONAR_InZone(ZONE_MIN_CM, ZONE_MAX_CM)
+        && set_disarm_flag == 0 && set_intruder_flag == 0)
+    {
+        alarm_timer_start = now;
+        set_intruder_flag = 1;
+    }
+    // timeouts (these used Timer3 and Timer5, which now trigger the sonar array)
+    if ((unsigned int)(now - alarm_timer_start) >= INTRUDER_MS) {
+        set_intruder_flag = 0;
     }
-    else  // Falling edge
+    if ((unsigned int)(now - alarm_timer_start) >= PASSCODE_MS) {
+        set_passcode_flag = 0;
+    }
+    if (set_disarm_flag == 1 && (unsigned int)(now - disarm_start) >= DISARM_MS) {
+        set_disarm_flag = 0;
+    }
+    // standby
+    if (KeyPresses == 0)
     {
-        TCCR4B |= (1<<ICES4); // Next time detect rising edge (ICESn = 1)
-        falling = ICR4; // Save current count (end-time)
-        counts = falling-rising;
-        dist = (us_per_count*counts)/(59);  // (usec/(2*29.4 usec/cm)) to get distance in cm
-        // distance-string, used for diagnostics
-        sprintf(textToWrite, "%d", dist);
+        first_digit = second_digit = third_digit = fourth_digit = 0;
     }
 }
 
-/*
-  We need to supply a short 10 uS pulse to the trigger input (TRIGpin) to start the ranging.
-  Then the module will send out an 8 cycle burst of ultrasound at 40 kHz and raise its echo. 
-  - From data-sheet (Ultrasonic Ranging Module HC-SR04)
-*/
-ISR (TIMER4_COMPA_vect)
+// RGB-LED and buzzer
+void indicator_task()
 {
-    PORTL |= (1<<TRIGpin);
-    _delay_us(10);
-    PORTL &= ~(1<<TRIGpin);
+    if (set_disarm_flag == 1)
+    {
+        PORTK = (1<<G_LED); // green LED on
+    }
+    else if (set_intruder_flag == 1 && set_passcode_flag == 0)
+    {
+        // red LED + buzzer, pulsing
+        if (SCHED_Millis() % (ALARM_ON_MS + ALARM_OFF_MS) < ALARM_ON_MS) {
+            PORTK = (1<<R_LED | 1<<BUZZER);
+        }
+        else {
+            PORTK = 0x00;
+        }
+    }
+    else if (KeyPresses != 0 && (set_passcode_flag == 1 || new_passcode_flag == 1))
+    {
+        PORTK = (1<<B_LED); // blue LED while digits are entered
+    }
+    else
+    {
+        PORTK = 0x00; // no alarm
+    }
 }
 
-void init_timer3() // Configure to generate an interrupt after a 10 and 30 seconds
+// LCD: compose the screen in the framebuffer, the flush only sends changed cells
+void display_task()
 {
-    TCCR3A = 0x00;  // Normal port operation (OC1A, OC1B), Clear Timer on 'Compare Match' (CTC) waveform mode)
-    TCCR3B = (1<<WGM32 | 1<<CS32 | 1<<CS30);  // CTC waveform mode, use prescaler 1024
+    static unsigned char DisplayOn = 0xFF;
+    unsigned char Screen = SCREEN_OFF;
 
-    // 20 sec -> ((20 sec * 1 MHz ) / 1024 prescaler) = 0x4c4b
-    OCR3AH = 0x4c;
-    OCR3AL = 0x4b;
+    if (set_disarm_flag == 1) {
+        Screen = SCREEN_DISARMED;
+    }
+    else if (set_intruder_flag == 1 && set_passcode_flag == 0) {
+        Screen = SCREEN_ALARM;
+    }
+    else if (set_passcode_flag == 1 && KeyPresses == 0) {
+        Screen = SCREEN_ENTER_CODE;
+    }
+    else if (set_passcode_flag == 1 && new_passcode_flag == 0 && KeyPresses <= 4) {
+        Screen = SCREEN_DIGITS + KeyPresses - 1; // one '*' per digit entered
+    }
 
-    // 30 sec -> ((30 sec * 1 MHz ) / 1024 prescaler) = 0x7271
-    OCR3BH = 0x72;
-    OCR3BL = 0x71;
+    LCD_FB_Clear();
+    if (Screen == SCREEN_DISARMED)
+    {
+        LCD_FB_WriteString(0, TopRow, "DISARMED");
+    }
+    else if (Screen == SCREEN_ALARM)
+    {
+        LCD_FB_WriteString(0, TopRow, "OBJECT");
+        LCD_FB_WriteString(0, BottomRow, "DETECTED");
+    }
+    else if (Screen == SCREEN_ENTER_CODE)
+    {
+        LCD_FB_WriteString(0, TopRow, "Enter passcode: ");
+    }
+    else if (Screen >= SCREEN_DIGITS)
+    {
+        for (unsigned char i = SCREEN_DIGITS; i <= Screen; i++) { // indicate how many digits are entered
+            LCD_FB_WriteChar(1 + i - SCREEN_DIGITS, TopRow, '*');
+        }
+    }
+    LCD_FB_Flush();
 
-    TCNT3H = 0x00;  // Timer/Counter count/value registers (16 bit) TCNT3H and TCNT3L
-    TCNT3L = 0x00;
-    TIMSK3 = (1<<OCIE3B | 1<<OCIE3A);  /* Use 'Output Compare (A, B) Match' Interrupt, i.e. generate an interrupt
-                                          when the timer reaches the set value (in the OCR3(A, B) registers) */
+    if (DisplayOn != (Screen != SCREEN_OFF)) // only send ON/OFF when it changes
+    {
+        DisplayOn = (Screen != SCREEN_OFF);
+        LCD_Display_ON_OFF(DisplayOn, false, false);
+    }
 }
 
-// Interrupt Handlers for Timer 3
-ISR(TIMER3_COMPA_vect) { set_intruder_flag = 0; }
-ISR(TIMER3_COMPB_vect) { set_passcode_flag = 0; }
-
-void init_timer5()     // Configure to generate an interrupt after a 60 Second interval
-{
-    TCCR5A = 0x00;  // Normal port operation (OC1A, OC1B, OC1C), Clear Timer on 'Compare Match' (CTC) waveform mode)
-    TCCR5B =  (1<<WGM52 | 1<<CS52 | 1<<CS50); // CTC waveform mode, prescaler=1024
+void InitialiseGeneral()
+{   
+    /*  RGB-LED + buzzer  */
+    DDRK |=  (1<<BUZZER | 1<<B_LED | 1<<G_LED | 1<<R_LED); // Configure PortK direction for Output
+    PORTK &= ~(1<<BUZZER | 1<<B_LED | 1<<G_LED | 1<<R_LED); // Set all LEDs + buzzer initially off
 
-    // ((60 sec * 1000000 MHz ) / 1024 prescaler) = 0xe4e2
-    OCR5AH = 0xe4;
-    OCR5AL = 0xe2;
+    /*  KeyPad (scanned by Timer2)  */
+    KEYPAD_Init();
 
-    // Timer/Counter count/value registers
-    TCNT5H = 0x00;
-    TCNT5L = 0x00;
-    TIMSK5 = (1<<OCIE5A); // 'Output Compare A Match' Interrupt
+    /*  LCD */
+    LCD_Initilise(true, false);
+    LCD_ShiftDisplay(false, true);
+    LCD_Display_ON_OFF(true, false, false);
+    // Display a fixed message on the top and bottom row of the LCD
+    LCD_Clear();
+    LCD_Home();
+    LCD_WriteStringAt(0, TopRow, "CWK-ESP5200");
+    LCD_WriteStringAt(0, BottomRow, "Victor Hansen");
+    _delay_ms(5000);
+    
+    asm ("sei"); // Enable interrupts
 }
 
-ISR(TIMER5_COMPA_vect) { set_disarm_flag = 0; }
-
-ISR(USART0_RX_vect) // USART Receive-Complete Interrupt Handler
+// handle one line received on USART0 (called from the main loop, not an ISR)
+void serial_command(char* sLine)
 {
-    char cData = UDR0;
+    char sCount[8];
+    char sTask[32];
+    char* p;
+    unsigned int iCounters[4];
+    unsigned char sreg;
+
+    for (unsigned char i = 0; sLine[i] != '\0'; i++) // commands are case insensitive
+    {
+        if (sLine[i] >= 'A' && sLine[i] <= 'Z') {
+            sLine[i] += 'a' - 'A';
+        }
+    }
     // set new passcode
-    if (cData == 'p')
+    if (strcmp(sLine, "p") == 0)
     {
         USART0_TX_String("\nSet new passcode:\r\n");
         new_passcode_flag = 1;
-        TCNT3H = 0x00;  // Timer/Counter count/value registers
-        TCNT3L = 0x00;
+        alarm_timer_start = SCHED_Millis();
         set_passcode_flag = 1;
     }
     // done setting passcode
-    else if (cData == 'q')
+    else if (strcmp(sLine, "q") == 0)
     {
         USART0_TX_String("\nPasscode set\r\n");
         new_passcode_flag = 0;
         set_passcode_flag = 0;
-        _delay_ms(500);
     }
-    // print distance (diagnostic) 
-    else if (cData == 'd')
+    // print distance (diagnostic)
+    else if (strcmp(sLine, "d") == 0)
     {
         new_passcode_flag = 0;
         USART0_TX_String("\nDistance in cm: \r\n");
-        USART0_TX_String(textToWrite);
-        _delay_ms(500);
+        for (unsigned char i = 0; i < SONAR_SENSORS; i++)
+        {
+            FMT_Int(sCount, sonar[i].distance_cm); // formatted only when asked for
+            USART0_TX_String(sCount);
+        }
+    }
+    // "code 1234": set the passcode directly, digits 1-9 match keys S1-S9
+    else if (strncmp(sLine, "code ", 5) == 0)
+    {
+        sLine += 5;
+        if (strlen(sLine) != 4)
+        {
+            USART0_TX_String("\nPasscode must be 4 digits\r\n");
+            return;
+        }
+        for (unsigned char i = 0; i < 4; i++)
+        {
+            if (sLine[i] < '1' || sLine[i] > '9')
+            {
+                USART0_TX_String("\nPasscode digits must be 1-9\r\n");
+                return;
+            }
+        }
+        for (unsigned char i = 0; i < 4; i++) {
+            passcode[i] = sLine[i] - '0';
+        }
+        new_passcode_flag = 0;
+        USART0_TX_String("\nPasscode set\r\n");
+    }
+    // print USART error counters
+    else if (strcmp(sLine, "stat") == 0)
+    {
+        sreg = SREG; // counters are 16 bit and updated by ISRs
+        cli();
+        iCounters[0] = usart0_rx_overruns;
+        iCounters[1] = usart0_rx_frame_errors;
+        iCounters[2] = usart0_rx_dropped;
+        iCounters[3] = usart0_tx_dropped;
+        SREG = sreg;
+        USART0_TX_String("\nRX overrun / framing / dropped, TX dropped:");
+        for (unsigned char i = 0; i < 4; i++)
+        {
+            FMT_Uint(sCount, iCounters[i]);
+            USART0_TX_String(sCount);
+        }
+    }
+    // print sonar ping rate (tuning the adaptive rate)
+    else if (strcmp(sLine, "sonar") == 0)
+    {
+        USART0_TX_String("\nPeriod us / pings per min:");
+        p = FMT_Ulong(sTask, (unsigned long)sonar_period_counts * SONAR_US_PER_COUNT);
+        *p++ = ' ';
+        FMT_Uint(p, sonar_pings_per_minute);
+        USART0_TX_String(sTask);
+        USART0_TX_String("Sensor: timeouts / invalid / ignored triggers");
+        for (unsigned char i = 0; i < SONAR_SENSORS; i++)
+        {
+            p = FMT_Text(FMT_Uint(sTask, i), ": ");
+            p = FMT_Uint(p, sonar[i].timeouts);
+            *p++ = ' ';
+            p = FMT_Uint(p, sonar[i].invalid);
+            *p++ = ' ';
+            FMT_Uint(p, sonar[i].ignored);
+            USART0_TX_String(sTask);
+        }
+    }
+    // print sleeps and the longest wake-to-handler time per sleep mode
+    else if (strcmp(sLine, "power") == 0)
+    {
+        USART0_TX_String("\nMode: sleeps / max wake us (idle, adc, save, down)");
+        for (unsigned char i = 0; i < POWER_MODES; i++)
+        {
+            p = FMT_Text(FMT_Uint(sTask, i), ": ");
+            p = FMT_Uint(p, power_sleeps[i]);
+            *p++ = ' ';
+            FMT_Uint(p, power_wake_us_max[i]);
+            USART0_TX_String(sTask);
+        }
+    }
+    // print scheduler task periods and measured run times
+    else if (strcmp(sLine, "tasks") == 0)
+    {
+        USART0_TX_String("\nTask: period ms / last us / max us");
+        for (unsigned char i = 0; i < sched_task_count; i++)
+        {
+            p = FMT_Text(FMT_Uint(sTask, i), ": ");
+            p = FMT_Uint(p, sched_tasks[i].period);
+            *p++ = ' ';
+            p = FMT_Uint(p, sched_tasks[i].runtime_us);
+            *p++ = ' ';
+            FMT_Uint(p, sched_tasks[i].runtime_max_us);
+            USART0_TX_String(sTask);
+        }
+    }
+    // print LCD bus writes: last flush / total / number of flushes
+    else if (strcmp(sLine, "lcd") == 0)
+    {
+        p = FMT_Uint(sTask, lcd_fb_bytes_last);
+        *p++ = ' ';
+        p = FMT_Ulong(p, lcd_fb_bytes_total);
+        *p++ = ' ';
+        FMT_Uint(p, lcd_fb_flushes);
+        USART0_TX_String("\nLCD bytes last flush / total / flushes:");
+        USART0_TX_String(sTask);
+        p = FMT_Uint(sTask, lcd_queue_high_water);
+        *p++ = ' ';
+        FMT_Uint(p, lcd_queue_full_stalls);
+        USART0_TX_String("LCD queue high water / full stalls:");
+        USART0_TX_String(sTask);
+    }
+#ifdef PROFILER
+    // print run time and entry latency per ISR (profiler_2560.h)
+    else if (strcmp(sLine, "isr") == 0)
+    {
+        usart0_tx_policy = USART0_TX_BLOCK; // longer than the TX buffer
+        PROFILER_Print(USART0_TX_String);
+        usart0_tx_policy = USART0_TX_FULL_POLICY;
+    }
+    else if (strcmp(sLine, "isr clear") == 0) {
+        PROFILER_Reset();
+    }
+#endif
+    else
+    {
+        USART0_TX_String("\nUnknown command\r\n");
     }
 }
 
-// function for handling the values entered on the keypad
+// function for handling the values entered on the keypad (called once per key press)
 void pressing_keypad(unsigned char KeyValue)
 {
-    _delay_ms(100);
     KeyPresses++;
-    _delay_ms(100); // debounce delay
 
     if (KeyValue == 16) // enter passcode
     {
-        TCNT3H = 0x00; // reset timer3 counters
-        TCNT3L = 0x00;
+        alarm_timer_start = SCHED_Millis(); // restart the 30 s passcode timeout
         set_passcode_flag = 1; // allow the user to enter a passcode
         set_intruder_flag = 0; // intruder flag
         KeyPresses = 0;
         new_passcode_flag = 0;
-        LCD_Display_ON_OFF(true, false, false);
-        LCD_Clear();
-        LCD_SetCursorPosition(0,TopRow);
-        LCD_WriteString("Enter passcode: ");
-        _delay_ms(1000);
     }
     else if (KeyValue == 13) // soft-reset in case the user does not want to enter a passcode
     {
-        PORTK = 0x00;
-        LCD_Clear();
         set_passcode_flag = 0; // user does not enter a passcode
-        KeyValue = NoKey;
+        KeyPresses = 0;
     }
     else if (new_passcode_flag == 1 && KeyPresses < 5) // setting new passcode via USART and keypad
     {
-        _delay_ms(100);
-        PORTK = (1<<B_LED); // blue LED
         passcode[KeyPresses-1] = KeyValue;
-        _delay_ms(100);
+        for (int i=0; i<4; i++)
+        {
+            USART0_TX_SingleByte(passcode[i]+48);   // print current passcode
+        }
+        USART0_TX_String("\n");
     }
     else if (set_passcode_flag == 1) // the user has 30 seconds to enter a 4-digit passcode
     {
-        PORTK = (1<<B_LED);
-        // get first digit of code
-        if (KeyPresses == 1) 
-        {
+        if (KeyPresses == 1) {
             first_digit = KeyValue;
-            LCD_Display_ON_OFF(true, false, false);
-            LCD_Clear();
-            LCD_SetCursorPosition(1,TopRow);
-            LCD_WriteString("*"); // indicate that user has entered a single digit
-            _delay_ms(750);
         }
-        else if (KeyPresses == 2)  // 2 of 4 digits of passcode entered
-        {
+        else if (KeyPresses == 2) { // 2 of 4 digits of passcode entered
             second_digit = KeyValue;
-            LCD_Clear();
-            LCD_SetCursorPosition(1,TopRow);
-            LCD_WriteString("**");
-            _delay_ms(750);
         }
-        else if (KeyPresses == 3) // 3 of 4 digits of passcode entered
-        {
+        else if (KeyPresses == 3) { // 3 of 4 digits of passcode entered
             third_digit = KeyValue;
-            LCD_Clear();
-            LCD_SetCursorPosition(1,TopRow);
-            LCD_WriteString("***");
-            _delay_ms(750);
         }
-        else if (KeyPresses == 4)  // 4 of 4 digits of passcode entered
-        {
+        else if (KeyPresses == 4) { // 4 of 4 digits of passcode entered
             fourth_digit = KeyValue;
-            LCD_Clear();
-            LCD_SetCursorPosition(1,TopRow);
-            LCD_WriteString("****");
-            _delay_ms(750);
         }
-        else if (KeyPresses > 4) // only allow 4 digit passcodes
+        else { // only allow 4 digit passcodes
             KeyPresses = 0;
+        }
     }
+    SCHED_Trigger(display_task_id); // show the change without waiting for the next period
 }
@@ -0,0 +1,631 @@
+/*
+  sonar.h
+
+  Array of up to four HC-SR04 ultrasonic sensors, one per 16-bit timer.
+  Datasheet:
+  https://cdn.sparkfun.com/datasheets/Sensors/Proximity/HCSR04.pdf
+  Range: 2 cm - 400 cm
+  - - - - - - - - - - - - - - - - -
+  VCC    <-> 5V
+  GND    <-> GND
+  Sensor  Timer  ECHO           TRIG
+  0       4      PL0 (ICP4)     PH4 (OC4B, digital pin 7)
+  1       5      PL1 (ICP5)     PL4 (OC5B, digital pin 45)
+  2       3      PE7 (ICP3)     PE4 (OC3B, digital pin 2)
+  3       1      PD4 (ICP1)     PB6 (OC1B, digital pin 12)
+  SONAR_SENSORS (1-4) selects how many are fitted, in this order.
+  - - - - - - - - - - - - - - - - -
+
+  The trigger pulse is made by the timer hardware: each timer runs in Fast PWM
+  mode with TOP = OCRnA (the ping period), OCnB goes high at BOTTOM and low
+  at OCRnB, so every period starts with a 16 us pulse on TRIG without any
+  interrupt or CPU time.
+
+  Range gating: SONAR_SetMaxRange() sets OCRnC to the time an echo from the
+  maximum range of interest can take. If the echo has not ended by then,
+  TIMERn_COMPC_vect queues a timeout (invalid sample) instead of waiting,
+  and the period (OCRnA) is cut to that gate plus a settling time for
+  stray echoes, so close range is sampled several times faster than the
+  70 ms full-range cycle (3.8x at a 50 cm gate) while a target is inside
+  the gate.
+  With nothing in range the HC-SR04 holds ECHO high for about 38 ms
+  (SONAR_ECHO_HOLD_MS) and ignores every trigger until it drops. So after
+  a timeout the period is kept at SONAR_HOLD_COUNTS (the hold plus the echo
+  delay and a guard, 39.6 ms = 1.8x the full-range rate) until a sensor
+  sees an echo again, instead of pinging into a busy sensor. A ping that
+  still gets no rising edge before the gate was not heard by the sensor:
+  it is counted in .ignored, not as a timeout, and does not reach the
+  filter.
+
+  Staggering: all timers share one period, and sensor i starts its ping
+  i * (gate + SONAR_CROSSTALK_MS) after sensor 0. A burst reflected by an
+  object beyond the gate keeps arriving after that gate has closed, for
+  as long as a sensor waits for its own stray echoes (SONAR_SETTLE_MS, the
+  default guard), so the next sensor only opens its gate once they have
+  died out. The period is never shorter than SONAR_SENSORS such slots:
+  the aggregate ping rate stays that of one sensor with its settle time,
+  each sensor gets 1 / SONAR_SENSORS of it (4 sensors at a 50 cm gate:
+  74 ms per sensor instead of 18.6 ms). A shorter SONAR_CROSSTALK_MS buys
+  rate back at the risk of a false short reading from another sensor's
+  echo of a far object.
+
+  Adaptive ping rate: the gated period is the fastest rate. While the
+  readings are stable the period grows by 1/8 per ping up to
+  SONAR_SLOW_PERIOD_MS. As soon as the distance seen by any sensor changes
+  faster than SONAR_MOTION_CM_S (or an object appears) it drops back to the
+  fastest rate.
+  A new period is not written at an arbitrary moment: SONAR_SetPeriodCounts()
+  leaves it pending, TIMER4_OVF_vect (sensor 0 at TOP) writes OCR4A, which
+  the timer loads at the following BOTTOM, and arms the overflow interrupt
+  of every other sensor. Each of them writes its own OCRnA at its next TOP,
+  i * stagger later in the same period. So every sensor runs exactly one
+  more old period from its own BOTTOM and then the new one: the change
+  moves all BOTTOMs by the same amount and the stagger is kept. A timer
+  only loads OCRnA at its BOTTOM, so writing all four at once would give
+  the sensors past their BOTTOM one old period more than the others and
+  shift the stagger by (new - old) at every rate change.
+
+  Sample pipeline (per sensor):
+  1. The capture ISR only measures the echo pulse and pushes the raw count
+     (and the time the echo ended) into the sensor's raw buffer.
+  2. SONAR_Process(), called from the main loop, converts the counts to cm
+     with a fixed-point reciprocal multiply (no division), rejects samples
+     outside the gate, and runs a median-of-N + EMA filter.
+  3. The result is published in sonar[i].distance_cm / .distance_time.
+  The capture/gate code is shared, each vector only passes its sensor.
+  Timestamps are ticks of timebase_2560.h when the firmware includes it
+  first: the end of the echo exactly, from the capture register's age
+  (SONAR_NOW). Without it (all four 16-bit timers are sensors) they fall
+  back to sched_ticks from scheduler.h, in ms.
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "../../common/profiler_2560.h"
+
+#ifndef SONAR_SENSORS
+#define SONAR_SENSORS           1   // 1-4, see the table above
+#endif
+
+#define SONAR_PRESCALER         8   // CSn1
+#define SONAR_US_PER_COUNT      8   // 1 MHz / prescaler 8
+#ifndef SONAR_PING_PERIOD_MS
+#define SONAR_PING_PERIOD_MS    70  // the datasheet suggests over 60 ms
+#endif
+#define SONAR_PERIOD_COUNTS     (SONAR_PING_PERIOD_MS * 1000UL / SONAR_US_PER_COUNT)
+// trigger pulse: at least 10 us, in whole counts
+#define SONAR_TRIG_COUNTS       ((10 + SONAR_US_PER_COUNT - 1) / SONAR_US_PER_COUNT)
+#define SONAR_US_PER_CM         59  // round trip: 2 * 29.4 us per cm
+// cm per count in Q16 fixed point: cm = (counts * SONAR_CM_Q16) >> 16
+#define SONAR_CM_Q16            ((65536UL * SONAR_US_PER_COUNT + SONAR_US_PER_CM / 2) / SONAR_US_PER_CM)
+#define SONAR_MIN_CM            2
+#define SONAR_MAX_CM            400
+#define SONAR_ECHO_DELAY_US     600 // trigger to rising echo edge (8 x 40 kHz burst + module delay)
+#ifndef SONAR_SETTLE_MS
+#define SONAR_SETTLE_MS         15  // after the gate, for echoes from far objects to die out
+#endif
+#define SONAR_STAGGER_GUARD_US  1000    // extra time after the echo hold (SONAR_HOLD_COUNTS)
+#ifndef SONAR_CROSSTALK_MS
+#define SONAR_CROSSTALK_MS      SONAR_SETTLE_MS // between one sensor's gate and the next one's trigger
+#endif
+#ifndef SONAR_ECHO_HOLD_MS
+#define SONAR_ECHO_HOLD_MS      38  // ECHO high with no obstacle (datasheet), triggers are ignored
+#endif
+#define SONAR_HOLD_COUNTS       ((SONAR_ECHO_DELAY_US + SONAR_ECHO_HOLD_MS * 1000UL + SONAR_STAGGER_GUARD_US) \
+                                 / SONAR_US_PER_COUNT)
+#define SONAR_TIMEOUT           0xFFFF  // raw sample value: no echo before the gate
+#define SONAR_IGNORED           0xFFFE  // raw sample value: no rising edge either, trigger not heard
+#ifndef SONAR_SLOW_PERIOD_MS
+#define SONAR_SLOW_PERIOD_MS    150 // ping period for a static scene
+#endif
+#ifndef SONAR_MOTION_CM_S
+#define SONAR_MOTION_CM_S       20  // speed that counts as motion
+#endif
+#define SONAR_RATE_WINDOW_MS    10000   // pings per minute are counted over 10 s
+
+// time stamps: ticks 'age_counts' sonar timer counts ago
+#ifdef TIMEBASE_2560_H
+#define SONAR_TICKS_PER_S       TIMEBASE_TICKS_PER_S
+#define SONAR_NOW(age_counts)   (TIMEBASE_Now() - (unsigned long)(age_counts) * SONAR_PRESCALER / TIMEBASE_PRESCALER)
+#else
+#define SONAR_TICKS_PER_S       1000UL
+#define SONAR_NOW(age_counts)   ((unsigned long)sched_ticks)   // ISRs don't nest, safe to read
+#endif
+#define SONAR_TICKS_MS(ms)      ((unsigned long)(ms) * (SONAR_TICKS_PER_S / 1000UL))
+
+#define SONAR_RAW_SIZE          8   // power of two
+#define SONAR_RAW_MASK          (SONAR_RAW_SIZE - 1)
+#ifndef SONAR_MEDIAN_N
+#define SONAR_MEDIAN_N          5   // odd, 1 = median filter off
+#endif
+#ifndef SONAR_EMA_SHIFT
+#define SONAR_EMA_SHIFT         1   // new sample weight 1/2^n, 0 = EMA off
+#endif
+
+#define SONAR_WAIT_RISING       0
+#define SONAR_WAIT_FALLING      1
+#define SONAR_DONE              2
+
+typedef struct
+{
+    unsigned int counts;    // echo pulse length in timer counts
+    unsigned long time;     // when the echo ended (SONAR_NOW)
+} SONAR_Sample;
+
+/*
+  One sensor. Timers 1, 3, 4 and 5 have the same register layout and bit
+  positions, so the same code drives any of them through these pointers.
+*/
+typedef struct
+{
+    // Timer n registers and the TRIG (OCnB) pin
+    volatile uint8_t  *tccra, *tccrb, *timsk, *tifr;
+    volatile uint16_t *icr, *ocra, *ocrb, *ocrc, *tcnt;
+    volatile uint8_t  *trig_ddr;
+    unsigned char trig_bit;
+
+    // written by the ISRs
+    volatile unsigned int rising;           // ICRn at the rising echo edge
+    volatile unsigned char echo_state;      // SONAR_WAIT_RISING / _FALLING / _DONE this period
+    volatile SONAR_Sample raw[SONAR_RAW_SIZE];
+    volatile unsigned char raw_head, raw_tail;
+    volatile unsigned int raw_dropped;      // raw buffer full
+    volatile unsigned int period_next;      // period for this sensor's next overflow ISR
+
+    // filter state (main context)
+    int16_t window[SONAR_MEDIAN_N];         // last N valid distances (cm)
+    unsigned char window_fill, window_pos;
+    unsigned int ema_q4;                    // EMA state, cm * 16
+    unsigned char invalid_run;              // invalid samples in a row
+    int16_t last_cm;                        // previous raw reading, for the motion check
+    unsigned long last_time;
+    bool timed_out;                         // last ping ended at the gate: the sensor may hold ECHO
+
+    // published by SONAR_Process()
+    int16_t distance_cm;                    // filtered distance, -1 = nothing in range
+    unsigned long distance_time;            // time of the newest sample in it (SONAR_NOW)
+    unsigned int invalid;                   // samples outside SONAR_MIN_CM..sonar_max_cm
+    unsigned int timeouts;                  // pings with no echo end before the gate
+    unsigned int ignored;                   // pings the sensor did not answer (still holding ECHO)
+} SONAR_Channel;
+
+SONAR_Channel sonar[SONAR_SENSORS] =
+{
+    { &TCCR4A, &TCCR4B, &TIMSK4, &TIFR4, &ICR4, &OCR4A, &OCR4B, &OCR4C, &TCNT4, &DDRH, PH4 },
+#if SONAR_SENSORS > 1
+    { &TCCR5A, &TCCR5B, &TIMSK5, &TIFR5, &ICR5, &OCR5A, &OCR5B, &OCR5C, &TCNT5, &DDRL, PL4 },
+#endif
+#if SONAR_SENSORS > 2
+    { &TCCR3A, &TCCR3B, &TIMSK3, &TIFR3, &ICR3, &OCR3A, &OCR3B, &OCR3C, &TCNT3, &DDRE, PE4 },
+#endif
+#if SONAR_SENSORS > 3
+    { &TCCR1A, &TCCR1B, &TIMSK1, &TIFR1, &ICR1, &OCR1A, &OCR1B, &OCR1C, &TCNT1, &DDRB, PB6 },
+#endif
+};
+
+unsigned int sonar_max_cm = SONAR_MAX_CM;       // range gate
+unsigned int sonar_gate_counts;                 // OCRnC
+unsigned int sonar_stagger_counts;              // offset between two sensors' pings
+unsigned int sonar_fast_counts;                 // fastest ping period (counts), from the gate
+unsigned int sonar_period_counts;               // current ping period (counts), all sensors
+unsigned int sonar_rate_counts;                 // period chosen by SONAR_Adapt(), before the echo hold
+volatile unsigned int sonar_period_pending = 0; // new period for TIMER4_OVF_vect, 0 = none
+bool sonar_adaptive = false;                    // SONAR_SetAdaptive()
+
+// ping rate statistics (all sensors)
+unsigned int sonar_pings_per_minute = 0;
+unsigned int sonar_ping_count = 0;      // pings in the current rate window
+unsigned long sonar_rate_start = 0;     // time the window started (SONAR_NOW)
+
+void SONAR_Init();
+void SONAR_SetMaxRange(unsigned int max_cm);
+void SONAR_SetPeriodCounts(unsigned int counts);
+void SONAR_SetAdaptive(bool bAdaptive);
+void SONAR_ApplyPeriod();
+void SONAR_Adapt(SONAR_Channel *ch, int16_t cm, unsigned long time);
+void SONAR_Process();
+unsigned char SONAR_InZone(int16_t min_cm, int16_t max_cm);
+int16_t SONAR_Median(SONAR_Channel *ch);
+
+void SONAR_Init()
+{
+    SONAR_Channel *ch;
+
+    for (unsigned char i = 0; i < SONAR_SENSORS; i++)
+    {
+        ch = &sonar[i];
+        *ch->trig_ddr |= (1<<ch->trig_bit); // OCnB drives TRIG
+
+        // Fast PWM, TOP = OCRnA (mode 15), clear OCnB on compare match, set OCnB at BOTTOM
+        // (bit positions are the same in every 16-bit timer, the Timer4 names are used)
+        *ch->tccra = (1<<COM4B1 | 1<<WGM41 | 1<<WGM40);
+        *ch->timsk = (1<<ICIE4 | 1<<OCIE4C); // echo capture + range gate
+        *ch->ocrb = SONAR_TRIG_COUNTS - 1;
+
+        ch->echo_state = SONAR_WAIT_RISING;
+        ch->distance_cm = ch->last_cm = -1;
+    }
+    /*  ICESn selects which edge on the Input Capture pin (ICPn) that is used to trigger a capture event.
+        ICESn bit = 0 --> a falling edge is used as trigger.
+        ICESn bit = 1 --> a rising edge will trigger the capture.
+        When a capture is triggered, the counter value is copied into the Input Capture Register (ICRn).
+    */
+
+    /*
+      70ms measurement cycle: 1MHz/8 = 125k counts/sec -> 12,5k counts/100ms
+      -> 12500/100*70 = 8750 counts per 70ms (TOP = 8749)
+      OCnB high for OCRnB+1 counts: 2 * 8 us = 16 us trigger pulse
+    */
+    SONAR_SetMaxRange(SONAR_MAX_CM); // sets the gate and period, starts the timers
+}
+
+/*
+  Only wait for echoes from objects up to max_cm away.
+  gate   = echo delay + max_cm * 59 us (round trip)
+  period = gate + SONAR_SETTLE_MS, the full range keeps the 70 ms cycle,
+           and at least SONAR_SENSORS stagger slots (gate + SONAR_CROSSTALK_MS).
+  e.g. 50 cm: gate = 0.6 + 2.95 = 3.55 ms, period = 18.55 ms (3.8x the 70 ms rate
+  while a target is in range, SONAR_HOLD_COUNTS after a timeout); with 4 sensors
+  the slots make it 74.2 ms.
+*/
+void SONAR_SetMaxRange(unsigned int max_cm)
+{
+    unsigned long gate_us, period_us, slots_us;
+    unsigned char sreg;
+    SONAR_Channel *ch;
+
+    if (max_cm > SONAR_MAX_CM) {
+        max_cm = SONAR_MAX_CM;
+    }
+    gate_us = SONAR_ECHO_DELAY_US + (unsigned long)max_cm * SONAR_US_PER_CM;
+    period_us = gate_us + SONAR_SETTLE_MS * 1000UL;
+    if (max_cm == SONAR_MAX_CM || period_us / SONAR_US_PER_COUNT > SONAR_PERIOD_COUNTS) {
+        period_us = SONAR_PERIOD_COUNTS * (unsigned long)SONAR_US_PER_COUNT;
+    }
+    // the slots win over the 70 ms cycle too (4 sensors at full range: 157 ms)
+    slots_us = SONAR_SENSORS * (gate_us + SONAR_CROSSTALK_MS * 1000UL);
+    if (period_us < slots_us) {
+        period_us = slots_us;
+    }
+    sonar_max_cm = max_cm;
+    sonar_gate_counts = gate_us / SONAR_US_PER_COUNT;
+    sonar_stagger_counts = (gate_us + SONAR_CROSSTALK_MS * 1000UL) / SONAR_US_PER_COUNT;
+    sonar_fast_counts = period_us / SONAR_US_PER_COUNT;
+    sonar_period_counts = sonar_rate_counts = sonar_fast_counts;
+
+    // Stop the prescaler while the counters are (re)phased, then start all timers together.
+    // 16-bit timer registers share TEMP with the capture ISRs, so interrupts stay off.
+    sreg = SREG;
+    cli();
+    GTCCR = (1<<TSM | 1<<PSRSYNC);
+    for (unsigned char i = 0; i < SONAR_SENSORS; i++)
+    {
+        ch = &sonar[i];
+        *ch->ocra = sonar_period_counts - 1;
+        *ch->ocrc = sonar_gate_counts;
+        // sensor i reaches BOTTOM (its trigger) i stagger slots after sensor 0
+        *ch->tcnt = i ? sonar_period_counts - i * sonar_stagger_counts : 0;
+        // Input Capture Noise Canceler / Input capture on rising edge / prescaler 8
+        *ch->tccrb = (1<<ICNC4 | 1<<ICES4 | 1<<WGM43 | 1<<WGM42 | 1<<CS41);
+        ch->echo_state = SONAR_WAIT_RISING;
+        *ch->timsk &= ~(1<<TOIE4);  // the period just written replaces any pending one
+        ch->timed_out = false;
+    }
+    sonar_period_pending = 0;
+    GTCCR = 0x00;
+    SREG = sreg;
+}
+
+// Ping period in timer counts (TOP + 1) for every sensor, from the BOTTOM after sensor 0's next TOP
+void SONAR_SetPeriodCounts(unsigned int counts)
+{
+    unsigned char sreg = SREG;
+    sonar_period_counts = counts;
+    cli();
+    sonar_period_pending = counts;
+    if (!(TIMSK4 & (1<<TOIE4)))
+    {
+        TIFR4 = (1<<TOV4);          // set at every TOP, only the next one counts
+        TIMSK4 |= (1<<TOIE4);
+    }
+    SREG = sreg;
+}
+
+/*
+  Overflow (TOP) of a sensor with a period change pending. The ISR starts
+  after the BOTTOM that follows (interrupt response and prologue take
+  longer than one timer count), so the interval now running keeps the old
+  period and the OCRnA written here is loaded at the next BOTTOM.
+*/
+static inline void SONAR_Overflow(SONAR_Channel *ch)
+{
+    *ch->timsk &= ~(1<<TOIE4);
+    *ch->ocra = ch->period_next - 1;
+}
+
+// Sensor 0 starts the change, the others follow at their own next TOP (in this period)
+ISR (TIMER4_OVF_vect)
+{
+    sonar[0].period_next = sonar_period_pending;
+    sonar_period_pending = 0;
+    SONAR_Overflow(&sonar[0]);
+    for (unsigned char i = 1; i < SONAR_SENSORS; i++)
+    {
+        sonar[i].period_next = sonar[0].period_next;
+        *sonar[i].tifr = (1<<TOV4);     // set at every TOP, only the next one counts
+        *sonar[i].timsk |= (1<<TOIE4);
+    }
+}
+#if SONAR_SENSORS > 1
+ISR (TIMER5_OVF_vect) { SONAR_Overflow(&sonar[1]); }
+#endif
+#if SONAR_SENSORS > 2
+ISR (TIMER3_OVF_vect) { SONAR_Overflow(&sonar[2]); }
+#endif
+#if SONAR_SENSORS > 3
+ISR (TIMER1_OVF_vect) { SONAR_Overflow(&sonar[3]); }
+#endif
+
+// Adaptive ping rate on/off (off = always the gated rate)
+void SONAR_SetAdaptive(bool bAdaptive)
+{
+    sonar_adaptive = bAdaptive;
+    sonar_rate_counts = sonar_fast_counts;
+    SONAR_ApplyPeriod();
+}
+
+// sonar_rate_counts, or the echo hold if a sensor timed out on its last ping
+void SONAR_ApplyPeriod()
+{
+    unsigned int period = sonar_rate_counts;
+
+    for (unsigned char i = 0; i < SONAR_SENSORS; i++)
+    {
+        if (sonar[i].timed_out && period < SONAR_HOLD_COUNTS) {
+            period = SONAR_HOLD_COUNTS;
+        }
+    }
+    if (period != sonar_period_counts) {
+        SONAR_SetPeriodCounts(period);
+    }
+}
+
+// Called for every ping: cm = raw reading (-1 = none). Speeds up on motion, slows down when static.
+void SONAR_Adapt(SONAR_Channel *ch, int16_t cm, unsigned long time)
+{
+    unsigned long dt = time - ch->last_time;
+    unsigned int slow = SONAR_SLOW_PERIOD_MS * 1000UL / SONAR_US_PER_COUNT;
+    unsigned int period = sonar_rate_counts;
+    int16_t delta = cm - ch->last_cm;
+    bool bMotion;
+
+    if (delta < 0) {
+        delta = -delta;
+    }
+    if (dt > SONAR_TICKS_PER_S) {
+        dt = SONAR_TICKS_PER_S; // long gap (first ping, fallback clock wrapped): keep the product in range
+    }
+    // |d cm / dt| > SONAR_MOTION_CM_S, without dividing; a new object also counts
+    bMotion = (cm >= 0 && ch->last_cm < 0)
+        || (cm >= 0 && (unsigned long)delta * SONAR_TICKS_PER_S > (unsigned long)SONAR_MOTION_CM_S * dt);
+    ch->last_cm = cm;
+    ch->last_time = time;
+
+    if (!sonar_adaptive) {
+        return;
+    }
+    if (bMotion) {
+        period = sonar_fast_counts;
+    }
+    else if (ch != &sonar[0]) {
+        return; // the slow decay is paced by sensor 0 only
+    }
+    else if (period < slow) {
+        period += period >> 3; // decay back to the slow rate
+        if (period > slow) {
+            period = slow;
+        }
+    }
+    sonar_rate_counts = period; // applied by SONAR_Process()
+}
+
+// Queue one raw sample (ISR context), its event was age_counts timer counts ago
+static inline void SONAR_Push(SONAR_Channel *ch, unsigned int counts, unsigned int age_counts)
+{
+    unsigned char next = (ch->raw_head + 1) & SONAR_RAW_MASK;
+    if (next == ch->raw_tail)
+    {
+        ch->raw_dropped++;
+        return;
+    }
+    ch->raw[ch->raw_head].counts = counts;
+    ch->raw[ch->raw_head].time = SONAR_NOW(age_counts);
+    ch->raw_head = next;
+}
+
+// Body of every TIMERn_CAPT_vect
+static inline void SONAR_Capture(SONAR_Channel *ch)
+{
+    /*  Rising edge (signal on the ICP pin goes from 0 -> 1):
+        switch ICP to falling edge detection and then store the 'start-time'.
+
+        Falling edge (1 -> 0): switch ICP to rising edge detection and queue the
+        pulse length, the conversion to cm is done by SONAR_Process().
+    */
+    unsigned int falling, counts, age;
+    unsigned int now = *ch->tcnt;
+
+    age = now - *ch->icr; // edge to handler
+    if (now < *ch->icr) {
+        age += *ch->ocra + 1; // across TOP
+    }
+#ifdef POWER_2560_H
+    POWER_WAKE_SAMPLE(age * SONAR_US_PER_COUNT);
+#endif
+    if (*ch->tccrb & (1<<ICES4)) // Rising edge
+    {
+        if (ch->echo_state != SONAR_WAIT_RISING) {
+            return; // this ping is already done (or timed out), ignore stray edges
+        }
+        *ch->tccrb &= ~(1<<ICES4); // Next time detect falling edge (ICESn = 0)
+        ch->rising = *ch->icr; // Save current count (start-time)
+        ch->echo_state = SONAR_WAIT_FALLING;
+    }
+    else  // Falling edge
+    {
+        *ch->tccrb |= (1<<ICES4); // Next time detect rising edge (ICESn = 1)
+        ch->echo_state = SONAR_DONE;
+        falling = *ch->icr; // Save current count (end-time)
+        counts = falling - ch->rising;
+        if (falling < ch->rising) {
+            counts += *ch->ocra + 1; // the counter passed TOP during the echo
+        }
+        SONAR_Push(ch, counts, age);
+    }
+}
+
+// Body of every TIMERn_COMPC_vect (range gate): the echo has not ended in time,
+// record a timeout (or an ignored trigger if it never started) and re-arm for the next ping
+static inline void SONAR_Gate(SONAR_Channel *ch)
+{
+    if (ch->echo_state != SONAR_DONE)
+    {
+        SONAR_Push(ch, (ch->echo_state == SONAR_WAIT_RISING) ? SONAR_IGNORED : SONAR_TIMEOUT,
+                   *ch->tcnt - *ch->ocrc); // the gate matched at OCRnC
+        *ch->tccrb |= (1<<ICES4); // look for the next rising edge
+    }
+    ch->echo_state = SONAR_WAIT_RISING;
+}
+
+// sensor 0 is profiled (profiler_2560.h), the others run the same code
+ISR (TIMER4_CAPT_vect)
+{
+    PROFILER_ENTER(PROFILER_TIMER4_CAPT, PROFILER_SINCE(TCNT4, ICR4, SONAR_PRESCALER));
+    SONAR_Capture(&sonar[0]);
+}
+ISR (TIMER4_COMPC_vect)
+{
+    PROFILER_ENTER(PROFILER_TIMER4_COMPC, PROFILER_SINCE(TCNT4, OCR4C, SONAR_PRESCALER));
+    SONAR_Gate(&sonar[0]);
+}
+#if SONAR_SENSORS > 1
+ISR (TIMER5_CAPT_vect)  { SONAR_Capture(&sonar[1]); }
+ISR (TIMER5_COMPC_vect) { SONAR_Gate(&sonar[1]); }
+#endif
+#if SONAR_SENSORS > 2
+ISR (TIMER3_CAPT_vect)  { SONAR_Capture(&sonar[2]); }
+ISR (TIMER3_COMPC_vect) { SONAR_Gate(&sonar[2]); }
+#endif
+#if SONAR_SENSORS > 3
+ISR (TIMER1_CAPT_vect)  { SONAR_Capture(&sonar[3]); }
+ISR (TIMER1_COMPC_vect) { SONAR_Gate(&sonar[3]); }
+#endif
+
+// Median of the sample window (insertion sort of a copy, N is small)
+int16_t SONAR_Median(SONAR_Channel *ch)
+{
+    int16_t sorted[SONAR_MEDIAN_N], value;
+    unsigned char i, j;
+    for (i = 0; i < SONAR_MEDIAN_N; i++)
+    {
+        value = ch->window[i];
+        for (j = i; j > 0 && sorted[j-1] > value; j--) {
+            sorted[j] = sorted[j-1];
+        }
+        sorted[j] = value;
+    }
+    return sorted[SONAR_MEDIAN_N / 2];
+}
+
+// Drain every sensor's raw samples and update its published distance (main context)
+void SONAR_Process()
+{
+    SONAR_Sample sample;
+    SONAR_Channel *ch;
+    int16_t cm;
+
+    for (unsigned char i = 0; i < SONAR_SENSORS; i++)
+    {
+        ch = &sonar[i];
+        while (ch->raw_tail != ch->raw_head)
+        {
+            sample.counts = ch->raw[ch->raw_tail].counts;
+            sample.time = ch->raw[ch->raw_tail].time;
+            ch->raw_tail = (ch->raw_tail + 1) & SONAR_RAW_MASK;
+
+            // rate statistics (every trigger sent)
+            sonar_ping_count++;
+            if (sample.time - sonar_rate_start >= SONAR_TICKS_MS(SONAR_RATE_WINDOW_MS))
+            {
+                sonar_pings_per_minute = sonar_ping_count * (60000UL / SONAR_RATE_WINDOW_MS);
+                sonar_ping_count = 0;
+                sonar_rate_start = sample.time;
+            }
+            if (sample.counts == SONAR_IGNORED)
+            {
+                ch->ignored++; // says nothing about the range, the hold stays as it is
+                continue;
+            }
+            ch->timed_out = (sample.counts == SONAR_TIMEOUT);
+            if (ch->timed_out)
+            {
+                ch->timeouts++;
+                cm = -1;
+            }
+            else {
+                cm = (int16_t)(((unsigned long)sample.counts * SONAR_CM_Q16) >> 16);
+            }
+            if (cm < SONAR_MIN_CM || cm > (int16_t)sonar_max_cm) {
+                cm = -1;
+            }
+            // adaptive ping period, kept above the echo hold after a timeout
+            SONAR_Adapt(ch, cm, sample.time);
+            SONAR_ApplyPeriod();
+            if (cm < 0)
+            {
+                // nothing in range, no echo (the HC-SR04 then holds ECHO high ~38 ms) or noise
+                ch->invalid++;
+                if (ch->invalid_run < 255) {
+                    ch->invalid_run++;
+                }
+                if (ch->invalid_run > SONAR_MEDIAN_N / 2)
+                {
+                    // most of the window is invalid: publish 'no reading' instead of a stale distance
+                    ch->distance_cm = -1;
+                    ch->distance_time = sample.time;
+                    ch->window_fill = 0;
+                }
+                continue;
+            }
+            ch->invalid_run = 0;
+
+            ch->window[ch->window_pos] = cm;
+            ch->window_pos = (ch->window_pos + 1) % SONAR_MEDIAN_N;
+            if (ch->window_fill < SONAR_MEDIAN_N)
+            {
+                ch->window_fill++;
+                if (ch->window_fill < SONAR_MEDIAN_N) {
+                    continue; // wait for a full window before publishing
+                }
+                ch->ema_q4 = SONAR_Median(ch) << 4;
+            }
+            ch->ema_q4 += ((int)(SONAR_Median(ch) << 4) - (int)ch->ema_q4) >> SONAR_EMA_SHIFT;
+            ch->distance_cm = (ch->ema_q4 + 8) >> 4;
+            ch->distance_time = sample.time;
+        }
+    }
+}
+
+// One pass over the distance table: bit i set = sensor i sees something in [min_cm, max_cm]
+unsigned char SONAR_InZone(int16_t min_cm, int16_t max_cm)
+{
+    unsigned char mask = 0;
+    for (unsigned char i = 0; i < SONAR_SENSORS; i++)
+    {
+        if (sonar[i].distance_cm >= min_cm && sonar[i].distance_cm <= max_cm) {
+            mask |= (1<<i);
+        }
+    }
+    return mask;
+}
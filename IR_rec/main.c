@@ -1,6 +1,4 @@
 
-// does not work...
-
 /*  - - - - - - - - - - - - - - - - -
     -  main.c
     -  Author: Victor J. Hansen
@@ -21,116 +19,186 @@
    VCC     <-> 5V
    GND     <-> GND
    OUT     <-> PL0 = ICP4 = 49 on board
+   - - - - - - - - - - - - - - - - -
+   IR LED (via transistor) <-> PH6 = OC2B = 9 on board
 */
 
+/*
+   NEC frame (receiver output is active low, a mark = carrier burst = low):
+     leader: 9 ms mark + 4.5 ms space
+     32 bits, LSB first: address, ~address, command, ~command
+       '0' = 562.5 us mark + 562.5 us space, '1' = 562.5 us mark + 1687.5 us space
+     stop:   562.5 us mark
+   While the key is held: repeat frame every 108 ms = 9 ms mark + 2.25 ms space + 562.5 us mark
+
+   The whole decoder runs in TIMER4_CAPT_vect: Timer4 is the 32-bit time
+   base (timebase_2560.h, 4 us per tick), each edge is extended to 32 bits
+   and timed against the previous one in integer ticks, so a gap longer
+   than a 16-bit wrap (262 ms) cannot alias to a valid length. The lengths
+   are checked against windows computed at compile time from F_CPU and the
+   prescaler. Decoded frames are queued as (address, command, repeat) events.
+
+   Learning / replay (any protocol): in learn mode the same ISR stores every
+   mark and space length in ir_raw[] (16-bit Timer4 ticks, starting with a
+   mark) until the line has been quiet for IR_RAW_GAP_US. Replay runs from
+   timer hardware: Timer2 makes the 38 kHz carrier on OC2B, Timer1 (also
+   4 us per tick) interrupts at the end of each mark / space and connects or
+   disconnects OC2B, so no CPU loop sets the timing.
+   Serial commands (end with Enter): learn, send, nec, dump, zdump, power,
+   and with -DPROFILER isr / isr clear (ISR cycles, see profiler_2560.h).
+   A dump can be pasted back to load it:
+     raw <n>                    start, n durations follow
+     r <ticks> <ticks> ...      durations (dump)
+     t <ticks> <ticks> ...      zdump: table of distinct durations
+     c <hex digits>             zdump: one table index per duration
+     end
+*/
 
 // AVR libraries
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
 // C libs
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define F_CPU 16000000UL  // 16 MHz
 
-#include <util/delay.h>
-
-
-#define CR  0x0D
-#define LF  0x0A // Line feed
-
-enum FSM { WAIT, CHECK, DONE }; 
+// screen /dev/cu.usbserial 9600
+// press Ctrl+a, type :quit and press Enter.
+#define USART0_TX_BUFFER_SIZE   64
+#define USART0_RX_BUFFER_SIZE   64
+#define USART0_TX_CRLF
+#define PROFILER_TIMER          3   // free Timer3 for the ISR profiler (-DPROFILER)
+#define TIMEBASE_TIMER          4   // edge time stamps
+#define TIMEBASE_PRESCALER      64
+#include "../common/usart_2560.h"
+#include "../common/power_2560.h"
+#include "../common/timebase_2560.h"
+#include "../common/format.h"
+
+// Timer4 ticks per us * 1000 (rounded down, 4 us per tick at 16 MHz / 64)
+#define IR_PRESCALER        TIMEBASE_PRESCALER
+#define IR_TICKS(us)        ((unsigned int)((us) * (F_CPU / 1000UL) / IR_PRESCALER / 1000UL))
+#define IR_TOLERANCE_PCT    25      // receiver modules stretch marks and shrink spaces
+#define IR_MIN(us)          IR_TICKS((us) * (100UL - IR_TOLERANCE_PCT) / 100UL)
+#define IR_MAX(us)          IR_TICKS((us) * (100UL + IR_TOLERANCE_PCT) / 100UL)
+#define IR_IN(t, us)        ((t) >= IR_MIN(us) && (t) <= IR_MAX(us))
+
+#define NEC_LEADER_MARK_US  9000UL
+#define NEC_LEADER_SPACE_US 4500UL
+#define NEC_REPEAT_SPACE_US 2250UL
+#define NEC_BIT_MARK_US     562UL
+#define NEC_ZERO_SPACE_US   562UL
+#define NEC_ONE_SPACE_US    1687UL
+#define NEC_BITS            32
+#define NEC_REPEAT_WINDOW_US 150000UL   // last frame / repeat to the end of the next repeat (108 ms apart)
+
+// decoder states
+enum NEC_STATE { NEC_IDLE, NEC_LEADER_MARK, NEC_LEADER_SPACE, NEC_BIT_MARK, NEC_BIT_SPACE, NEC_REPEAT_MARK };
+
+typedef struct
+{
+    unsigned int address;   // 8 bit, or 16 bit with IR_NEC_EXTENDED
+    unsigned char command;
+    unsigned char repeat;   // 0 = new key press, 1 = repeat frame (key held)
+} IR_Event;
+
+#define IR_EVENT_SIZE       8   // power of two
+#define IR_EVENT_MASK       (IR_EVENT_SIZE - 1)
+
+// learning / replay
+#define IR_RAW_SIZE         200     // marks + spaces, NEC is 67
+#define IR_RAW_GAP_US       20000UL // silence that ends a capture
+#define IR_TABLE_SIZE       16      // distinct durations in a compressed dump (one hex digit)
+#define IR_CARRIER_HZ       38000UL
+// Timer2, prescaler 8: period rounded to the nearest count, 53 counts (TOP 52) -> 37.7 kHz
+#define IR_CARRIER_TOP      ((F_CPU / 8 + IR_CARRIER_HZ / 2) / IR_CARRIER_HZ - 1)
+enum IR_MODE { IR_MODE_NEC, IR_MODE_LEARN, IR_MODE_SEND };
 
-void USART0_SETUP_9600_BAUD();
-void USART0_TX_SingleByte(unsigned char cByte);
-void USART0_TX_String(char* sData);
 void InitialiseGeneral();
-void timer1();
 void init_timer4();
-
-// vars for ultrasonic sensor
-volatile unsigned int elapsedTime, transmitTime;
-static unsigned char dataCnt = 0;
-volatile unsigned char timer3_cnt, elapseCnt = 0;
-volatile float spaceTime, startTime, endTime;
-volatile unsigned char rising, falling = 0;
-
-unsigned char state = WAIT;
+void init_ir_transmit();
+void IR_Learn();
+void IR_Send();
+void IR_Dump(unsigned char bCompress);
+unsigned char IR_Compress();
+void serial_command(char* sLine);
+void IR_Push(unsigned int address, unsigned char command, unsigned char repeat);
+void IR_LoadRangeError(unsigned long value);
+unsigned char IR_GetEvent(IR_Event* pEvent);
+
+// decoder state (TIMER4_CAPT_vect only)
+unsigned char ir_state = NEC_IDLE;
+unsigned long ir_last_edge;         // time of the previous edge (timebase ticks)
+unsigned long ir_data;              // bits received so far, LSB first
+unsigned char ir_bits;
+unsigned int ir_last_address;       // last valid frame, for repeats
+unsigned char ir_last_command;
+unsigned char ir_last_valid = 0;
+unsigned long ir_last_frame;        // end of the last valid frame or repeat (timebase ticks)
+
+// decoded events
+volatile IR_Event ir_events[IR_EVENT_SIZE];
+volatile unsigned char ir_event_head = 0, ir_event_tail = 0;
+volatile unsigned int ir_events_dropped = 0, ir_frame_errors = 0;
+
+// raw capture (learn mode) and replay buffer
+unsigned int ir_raw[IR_RAW_SIZE];   // Timer4 ticks: mark, space, mark, ...
+volatile unsigned char ir_raw_count = 0;
+volatile unsigned char ir_raw_started = 0;  // first mark seen
+volatile unsigned char ir_raw_done = 0;     // gap after the last mark, or buffer full
+volatile unsigned char ir_mode = IR_MODE_NEC;
+volatile unsigned char ir_send_index;       // duration being sent
+unsigned int ir_table[IR_TABLE_SIZE];       // compressed dump / load
+unsigned char ir_table_count = 0;
+unsigned char ir_load_expected = 0;
+unsigned char ir_raw_index[IR_RAW_SIZE];    // IR_Compress(): table index per duration
 
 static char textToWrite[32]  = {'\0'};
-static char receivedData[10] = {'\0'};
+static char commandLine[64];
 
 // - - - - - - - - - - - - - - - - -
 int main()
 {
+    IR_Event event;
+    char* pText;
+
     InitialiseGeneral();
-    timer1();
     init_timer4();
+    init_ir_transmit();
     USART0_SETUP_9600_BAUD();
+    // clocks of the peripherals this firmware does not use
+    POWER_Init((1<<PRTWI | 1<<PRTIM0 | 1<<PRSPI | 1<<PRADC),
+               (1<<PRTIM5 | 1<<PRTIM3 | 1<<PRUSART3 | 1<<PRUSART2 | 1<<PRUSART1));
+    PROFILER_Init(); // Timer3 clock on again while profiling
     
     while(1)
     {
-        /* if (strlen(receivedData > 6)) { */
-        /*     USART0_TX_String(receivedData); */
-        /*     USART0_TX_String("\n"); */
-        /* } */
-        
-        switch (state)
+        if (USART0_RX_GetLine(commandLine, sizeof(commandLine))) {
+            serial_command(commandLine);
+        }
+        if (ir_mode == IR_MODE_LEARN && ir_raw_done)
         {
-// - - - - - - - - - - - - - - - - -
-        case WAIT:
-            for (int i = 0; i < 10; ++i) { // clear output
-                receivedData[i] = '\0';
-            }
-            if (falling == 1) {
-                TCNT1H = 0x00;  // Timer/Counter count/value registers (16 bit)
-                TCNT1L = 0x00;
-                _delay_ms(31.5);
-                state=CHECK;
-            }
-            break;
-// - - - - - - - - - - - - - - - - - 
-        case CHECK:
-            if (falling == 1)
-            {
-                /* Logical '0' – a 562.5µs pulse burst followed by a 562.5µs space, 
-                   with a total transmit time of 1.125ms */
-
-                /* Logical '1' – a 562.5µs pulse burst followed by a 1.6875ms space,
-                   with a total transmit time of 2.25ms */
+            ir_mode = IR_MODE_NEC;
+            FMT_Uint(FMT_Text(textToWrite, "captured "), ir_raw_count);
+            USART0_TX_String(textToWrite);
+        }
+        while (IR_GetEvent(&event))
+        {
+            pText = FMT_Hex(FMT_Text(textToWrite, "NEC "), event.address, 4);
+            *pText++ = ' ';
+            FMT_Text(FMT_Hex(pText, event.command, 2), event.repeat ? " repeat" : "");
+            USART0_TX_String(textToWrite);
+        }
 
-                // Logic 0
-                if (spaceTime <= 564 && spaceTime > 562)
-                {
-                    receivedData[dataCnt] = '0';
-                    dataCnt++;
-                }
-                // Logic 1
-                else if (spaceTime > 1686 && spaceTime <= 1688) // 3*563
-                {
-                    receivedData[dataCnt] = '1';
-                    dataCnt++;
-                }
-            }
-            else if (dataCnt > 7)
-            {
-                dataCnt = 0;
-                state = DONE;
-            }
-            break;
-// - - - - - - - - - - - - - - - - - 
-        case DONE:
-            if (elapseCnt == 13)
-            {
-                // USART0_TX_String("complete \n\r");
-                state=WAIT;
-            }
-            break;
-        default:
-            break;
+        // everything arrives by interrupt: sleep until the next one
+        cli();
+        if (usart0_rx_head == usart0_rx_tail && ir_event_head == ir_event_tail
+            && !(ir_mode == IR_MODE_LEARN && ir_raw_done)) {
+            POWER_Sleep();
         }
+        sei();
     }
 }
 
@@ -140,52 +208,32 @@ void InitialiseGeneral()
     asm ("sei"); // Enable interrupts
 }
 
-// timer for total elapsed time
-// Timer1 (16 bits)
-void timer1()
+// time the edges of the IR receiver output
+void init_timer4()
 {
-    TCCR1A = 0x00;
-    TCCR1B = (1<<WGM12 | 1<<CS11);  // CTC waveform mode, prescaler = 8
-    
-    // 4.5 msec -> ((4.5 msec * 16 MHz ) / 8 prescaler) = 0x2328
-    
-    OCR1AH = 0x23; // Output Compare Registers (16 bit)
-    OCR1AL = 0x28;
+    // Normal mode (free running 16 bit) / prescaler 64, overflows counted by the time base
+    // (16 MHz / 64) / 1,000,000 counts/uSec = 1/4 counts/us
+    TIMEBASE_Init();
 
-    TCNT1H = 0x00;  // Timer/Counter count/value registers (16 bit)
-    TCNT1L = 0x00;
-    TIMSK1 = (1<<OCIE1A);  // generate an interrupt when the timer reaches the set value in the OCR1A register
+    // Input capture on falling edge
+    TCCR4B |= (1<<ICNC4);
+    TIMSK4 |= (1<<ICIE4); // Input Capture Interrupt Enable
 }
 
-
-ISR (TIMER1_COMPA_vect)
+// 38 kHz carrier on OC2B (disconnected until a mark is sent), Timer1 times the marks / spaces
+void init_ir_transmit()
 {
-    // 40.5 ms - 9 = 31.5 ms
-    // 67.5 ms - 9 = 58.5 ms
-    elapseCnt++;
-    if (elapseCnt > 14)
-    {
-        elapseCnt = 0;
-    }
-}
+    DDRH |= (1<<PH6);
+    PORTH &= ~(1<<PH6); // LED off while OC2B is disconnected
 
-// get rising edge of signal
-void init_timer4()
-{
-    TCCR4A = 0x00;
-    
-    // Input capture on falling edge / prescaler 64
-    TCCR4B = (1<<WGM42 | 1<<CS41 | 1<<CS40);
+    TCCR2A = (1<<WGM21 | 1<<WGM20);     // Fast PWM, TOP = OCR2A (mode 7), OC2B disconnected
+    TCCR2B = (1<<WGM22 | 1<<CS21);      // prescaler 8
+    OCR2A = IR_CARRIER_TOP;
+    OCR2B = IR_CARRIER_TOP / 3;         // ~33% duty cycle
 
-    // (16 MHz / 64) / 1,000,000 counts/uSec = 1/4 counts/us
-    // 4 us per count 
-    
-    TIMSK4 = (1<<ICIE4); // Input Capture Interrupt Enable
-
-    // set top value for counter
-    // 50 ms -> ((0.05 s * 16 MHz ) / 64 prescaler) = 0x30d4
-    OCR4AH = 0x30;
-    OCR4AL = 0xd4;
+    TCCR1A = 0x00;
+    TCCR1B = (1<<WGM12);    // CTC mode, TOP = OCR1A, stopped until IR_Send()
+    TIMSK1 = 0x00;
 }
 
 // get space time, period from falling edge until rising edge
@@ -212,66 +260,417 @@ void init_timer4()
 
 ISR (TIMER4_CAPT_vect)
 {
-    if (TCCR4B & (1<<ICES4)) // rising edge
-    {
+    PROFILER_ENTER(PROFILER_TIMER4_CAPT, PROFILER_SINCE(TCNT4, ICR4, IR_PRESCALER));
+    unsigned int now = ICR4;
+    unsigned long edge = TIMEBASE_Extend(now);
+    unsigned long gap = edge - ir_last_edge;
+    unsigned int t = (gap > 0xFFFF) ? 0xFFFF : gap;    // ticks since the previous edge
+    unsigned char rising = TCCR4B & (1<<ICES4);
+    unsigned char state = ir_state;
+
+    POWER_WAKE_SAMPLE((TCNT4 - now) * (IR_PRESCALER / (F_CPU / 1000000UL))); // edge to handler, ticks -> us
+
+    ir_last_edge = edge;
+    // next edge: the opposite of the level the pin has now (resynchronises after a missed edge)
+    if (PINL & (1<<PL0)) {
         TCCR4B &= ~(1<<ICES4);
-        // Next time detect falling edge (ICESn = 0)
-        rising = 1;
-        falling = 0;
-        endTime = ICR4;
-        spaceTime = endTime-startTime;
-        //   sprintf(textToWrite, "%f" , spaceTime);
     }
-    else  // Falling edge
+    else {
+        TCCR4B |= (1<<ICES4);
+    }
+
+    if (ir_mode == IR_MODE_LEARN)
+    {
+        if (ir_raw_done) {
+            return;
+        }
+        if (ir_raw_started) {
+            ir_raw[ir_raw_count++] = t; // the mark or space that this edge ends
+        }
+        else if (!rising) {
+            ir_raw_started = 1; // first mark
+        }
+        if (ir_raw_count == IR_RAW_SIZE) {
+            ir_raw_done = 1;
+        }
+        OCR4B = now + IR_TICKS(IR_RAW_GAP_US); // end of capture if no edge before this
+        TIFR4 = (1<<OCF4B);
+        TIMSK4 |= (1<<OCIE4B);
+        return;
+    }
+
+    if (!rising) // falling edge: a mark starts, t = space
+    {
+        if (state == NEC_LEADER_SPACE && IR_IN(t, NEC_LEADER_SPACE_US))
+        {
+            state = NEC_BIT_MARK;
+            ir_bits = 0;
+            ir_data = 0;
+        }
+        else if (state == NEC_LEADER_SPACE && IR_IN(t, NEC_REPEAT_SPACE_US)) {
+            state = NEC_REPEAT_MARK;
+        }
+        else if (state == NEC_BIT_SPACE && IR_IN(t, NEC_ZERO_SPACE_US))
+        {
+            ir_data >>= 1;
+            state = NEC_BIT_MARK;
+        }
+        else if (state == NEC_BIT_SPACE && IR_IN(t, NEC_ONE_SPACE_US))
+        {
+            ir_data = (ir_data >> 1) | 0x80000000UL;
+            state = NEC_BIT_MARK;
+        }
+        else
+        {
+            if (state != NEC_IDLE) {
+                ir_frame_errors++;
+            }
+            state = NEC_LEADER_MARK; // this mark may be the next leader
+        }
+        if (state == NEC_BIT_MARK) {
+            ir_bits++; // marks counted from 1, mark NEC_BITS + 1 is the stop bit
+        }
+    }
+    else // rising edge: a mark ends, t = mark
+    {
+        if (state == NEC_LEADER_MARK && IR_IN(t, NEC_LEADER_MARK_US)) {
+            state = NEC_LEADER_SPACE;
+        }
+        else if (state == NEC_BIT_MARK && IR_IN(t, NEC_BIT_MARK_US))
+        {
+            state = NEC_BIT_SPACE;
+            if (ir_bits == NEC_BITS + 1) // stop bit: frame complete
+            {
+                state = NEC_IDLE;
+                if ((unsigned char)(ir_data >> 16) == (unsigned char)~(ir_data >> 24)) // command
+                {
+                    if ((unsigned char)ir_data == (unsigned char)~(ir_data >> 8)) {
+                        ir_last_address = (unsigned char)ir_data;
+                    }
+                    else
+                    {
+#ifdef IR_NEC_EXTENDED
+                        ir_last_address = (unsigned int)ir_data; // 16-bit address, no inverse
+#else
+                        ir_frame_errors++;
+                        ir_state = NEC_IDLE;
+                        return;
+#endif
+                    }
+                    ir_last_command = (unsigned char)(ir_data >> 16);
+                    ir_last_valid = 1;
+                    ir_last_frame = edge;
+                    IR_Push(ir_last_address, ir_last_command, 0);
+                }
+                else {
+                    ir_frame_errors++;
+                }
+            }
+        }
+        else if (state == NEC_REPEAT_MARK && IR_IN(t, NEC_BIT_MARK_US))
+        {
+            state = NEC_IDLE;
+            if (ir_last_valid && edge - ir_last_frame <= TIMEBASE_US(NEC_REPEAT_WINDOW_US)) // key still held
+            {
+                ir_last_frame = edge;
+                IR_Push(ir_last_address, ir_last_command, 1);
+            }
+        }
+        else
+        {
+            if (state != NEC_IDLE) {
+                ir_frame_errors++;
+            }
+            state = NEC_IDLE;
+        }
+    }
+    ir_state = state;
+}
+
+// learn mode: no edge for IR_RAW_GAP_US, the capture is complete
+ISR (TIMER4_COMPB_vect)
+{
+    PROFILER_ENTER(PROFILER_TIMER4_COMPB, PROFILER_SINCE(TCNT4, OCR4B, IR_PRESCALER));
+    TIMSK4 &= ~(1<<OCIE4B);
+    if (ir_raw_started) {
+        ir_raw_done = 1;
+    }
+}
+
+// end of a mark or space being sent
+ISR (TIMER1_COMPA_vect)
+{
+    PROFILER_ENTER(PROFILER_TIMER1_COMPA, TCNT1 * IR_PRESCALER); // CTC: counts since the match
+    unsigned char index = ir_send_index + 1;
+    if (index >= ir_raw_count)
     {
-        TCCR4B |= (1<<ICES4); // Next time detect rising edge (ICESn = 1)
-        startTime = ICR4; // Save current count
-        rising = 0;
-        falling = 1;
+        TCCR2A &= ~(1<<COM2B1);     // carrier off
+        TCCR1B &= ~(1<<CS11 | 1<<CS10); // stop Timer1
+        TIMSK1 = 0x00;
+        ir_state = NEC_IDLE;
+        TIFR4 = (1<<ICF4);          // ignore what the receiver saw of our own signal
+        TIMSK4 |= (1<<ICIE4);
+        ir_mode = IR_MODE_NEC;
+        return;
+    }
+    if (index & 1) {
+        TCCR2A &= ~(1<<COM2B1);     // space
     }
+    else {
+        TCCR2A |= (1<<COM2B1);      // mark: connect the carrier to OC2B
+    }
+    OCR1A = ir_raw[index] - 1;      // Timer1 has already restarted from 0
+    ir_send_index = index;
 }
 
+// start learning: the next signal received is stored in ir_raw[]
+void IR_Learn()
+{
+    cli();
+    ir_raw_count = 0;
+    ir_raw_started = 0;
+    ir_raw_done = 0;
+    ir_mode = IR_MODE_LEARN;
+    sei();
+}
 
-// screen /dev/cu.usbserial 9600
-// press Ctrl+a, type :quit and press Enter. 
+// replay ir_raw[] (returns at once, the Timer1 interrupt does the rest)
+void IR_Send()
+{
+    if (ir_raw_count == 0 || ir_mode != IR_MODE_NEC) {
+        return;
+    }
+    cli();
+    ir_mode = IR_MODE_SEND;
+    TIMSK4 &= ~(1<<ICIE4);          // don't decode our own transmission
+    ir_send_index = 0;
+    OCR1A = ir_raw[0] - 1;
+    TCNT1 = 0;
+    TIFR1 = (1<<OCF1A);
+    TIMSK1 = (1<<OCIE1A);
+    TCCR2A |= (1<<COM2B1);          // first mark
+    TCCR1B |= (1<<CS11 | 1<<CS10);  // prescaler 64: 4 us per tick, same as the capture
+    sei();
+}
 
-void USART0_SETUP_9600_BAUD()
+// Build ir_table[] (durations within 1/8 of each other share an entry) and ir_raw_index[],
+// returns 0 if there are more than IR_TABLE_SIZE distinct durations
+unsigned char IR_Compress()
 {
-    // USART Control and Status Register A
-    UCSR0A = (1<<U2X0); // Double the USART Transmission Speed
-    // Writing this bit to one will reduce the divisor of the baud rate divider from 16 to 8 effectively doubling the transfer
-    //rate for asynchronous communication.
-
-    // USART Control and Status Register B
-    /* RX Complete Interrupt Enable, RX Enable, TX Enable, 8-bit data */
-    UCSR0B = (1<<RXCIE0 | 1<<RXEN0 | 1<<TXEN0);
-    
-    // USART Control and Status Register C
-    /* Asynchronous, No Parity, 1 stop, 8-bit data, Falling XCK edge */
-    UCSR0C = (1<<UCSZ01 | 1<<UCSZ00 | 1<<UCPOL0);
-  
-    // UBRR0 - USART Baud Rate Register (16-bit register, comprising UBRR0H and UBRR0L)
-    UBRR0H = 0; // 9600 baud, UBRR = 12, and  U2X must be set to '1' in UCSRA
-    UBRR0L = 207;
+    unsigned char i, j;
+    unsigned int d, diff;
+
+    ir_table_count = 0;
+    for (i = 0; i < ir_raw_count; i++)
+    {
+        d = ir_raw[i];
+        for (j = 0; j < ir_table_count; j++)
+        {
+            diff = (d > ir_table[j]) ? d - ir_table[j] : ir_table[j] - d;
+            if (diff <= ir_table[j] / 8) {
+                break;
+            }
+        }
+        if (j == ir_table_count)
+        {
+            if (ir_table_count == IR_TABLE_SIZE) {
+                return 0;
+            }
+            ir_table[ir_table_count++] = d;
+        }
+        ir_raw_index[i] = j;
+    }
+    return 1;
 }
 
-void USART0_TX_SingleByte(unsigned char cByte)
+// Print ir_raw[] in the load format, compressed if possible
+void IR_Dump(unsigned char bCompress)
 {
-    while( !(UCSR0A & (1 << UDRE0)) ); // Wait for Tx Buffer to become empty (check UDRE flag)
-    UDR0 = cByte;   // Writing to the UDR transmit buffer causes the byte to be transmitted
+    char sLine[56]; // "r " + 8 x " 65535"
+    unsigned char i, n = 0;
+
+    if (bCompress && !IR_Compress()) {
+        bCompress = 0; // too many distinct durations
+    }
+    usart0_tx_policy = USART0_TX_BLOCK; // longer than the TX buffer
+    FMT_Uint(FMT_Text(sLine, "raw "), ir_raw_count);
+    USART0_TX_String(sLine);
+    if (bCompress)
+    {
+        for (i = 0; i < ir_table_count; i++) // "t ..." lines, 8 per line
+        {
+            n = FMT_Uint(FMT_Text(sLine + n, (n == 0) ? "t " : " "), ir_table[i]) - sLine;
+            if ((i & 7) == 7 || i == ir_table_count - 1)
+            {
+                USART0_TX_String(sLine);
+                n = 0;
+            }
+        }
+        for (i = 0; i < ir_raw_count; i++) // "c ..." lines, 32 digits per line
+        {
+            if (n == 0)
+            {
+                sLine[n++] = 'c';
+                sLine[n++] = ' ';
+            }
+            sLine[n++] = "0123456789ABCDEF"[ir_raw_index[i]];
+            if ((i & 31) == 31 || i == ir_raw_count - 1)
+            {
+                sLine[n] = '\0';
+                USART0_TX_String(sLine);
+                n = 0;
+            }
+        }
+    }
+    else
+    {
+        for (i = 0; i < ir_raw_count; i++) // "r ..." lines, 8 per line
+        {
+            n = FMT_Uint(FMT_Text(sLine + n, (n == 0) ? "r " : " "), ir_raw[i]) - sLine;
+            if ((i & 7) == 7 || i == ir_raw_count - 1)
+            {
+                USART0_TX_String(sLine);
+                n = 0;
+            }
+        }
+    }
+    USART0_TX_String("end");
+    usart0_tx_policy = USART0_TX_FULL_POLICY;
 }
 
-void USART0_TX_String(char* sData)
+// handle one line received on USART0 (commands and dump lines being loaded)
+void serial_command(char* sLine)
 {
-    int iCount;
-    int iStrlen = strlen(sData);
-    if(0 != iStrlen)
+    char* pNext;
+    char* pText;
+    unsigned long value;
+
+    if (strcmp(sLine, "learn") == 0)
+    {
+        IR_Learn();
+        USART0_TX_String("learning, press a key on the remote");
+    }
+    else if (strcmp(sLine, "send") == 0) {
+        IR_Send();
+    }
+    else if (strcmp(sLine, "nec") == 0 && ir_mode == IR_MODE_LEARN) {
+        ir_mode = IR_MODE_NEC; // stop learning
+    }
+    else if (strcmp(sLine, "power") == 0)
+    {
+        USART0_TX_String("mode: sleeps / max wake us (idle, adc, save, down)");
+        for (unsigned char i = 0; i < POWER_MODES; i++)
+        {
+            pText = FMT_Text(FMT_Uint(textToWrite, i), ": ");
+            pText = FMT_Uint(pText, power_sleeps[i]);
+            *pText++ = ' ';
+            FMT_Uint(pText, power_wake_us_max[i]);
+            USART0_TX_String(textToWrite);
+        }
+    }
+#ifdef PROFILER
+    else if (strcmp(sLine, "isr") == 0)
+    {
+        usart0_tx_policy = USART0_TX_BLOCK; // longer than the TX buffer
+        PROFILER_Print(USART0_TX_String);
+        usart0_tx_policy = USART0_TX_FULL_POLICY;
+    }
+    else if (strcmp(sLine, "isr clear") == 0) {
+        PROFILER_Reset();
+    }
+#endif
+    else if (strcmp(sLine, "dump") == 0 || strcmp(sLine, "zdump") == 0) {
+        IR_Dump(sLine[0] == 'z');
+    }
+    else if (strncmp(sLine, "raw ", 4) == 0)
+    {
+        ir_mode = IR_MODE_NEC; // stop learning, the buffer is being loaded
+        ir_raw_count = 0;
+        ir_table_count = 0;
+        value = strtoul(sLine + 4, 0, 10);
+        ir_load_expected = (value > IR_RAW_SIZE) ? IR_RAW_SIZE : value;
+    }
+    else if (sLine[0] == 'r' && sLine[1] == ' ') // durations
+    {
+        sLine += 2;
+        while (ir_raw_count < IR_RAW_SIZE && (value = strtoul(sLine, &pNext, 10)) != 0 && pNext != sLine)
+        {
+            if (value > 0xFFFF)
+            {
+                IR_LoadRangeError(value); // not wrapped into a wrong length: the load ends in "load error"
+                break;
+            }
+            ir_raw[ir_raw_count++] = value;
+            sLine = pNext;
+        }
+    }
+    else if (sLine[0] == 't' && sLine[1] == ' ') // table of durations
     {
-        for(iCount = 0; iCount < iStrlen; iCount++)
+        sLine += 2;
+        while (ir_table_count < IR_TABLE_SIZE && (value = strtoul(sLine, &pNext, 10)) != 0 && pNext != sLine)
         {
-            USART0_TX_SingleByte(sData[iCount]);
+            if (value > 0xFFFF)
+            {
+                IR_LoadRangeError(value);
+                break;
+            }
+            ir_table[ir_table_count++] = value;
+            sLine = pNext;
         }
-        USART0_TX_SingleByte(CR);
-        USART0_TX_SingleByte(LF);
     }
+    else if (sLine[0] == 'c' && sLine[1] == ' ') // table indexes
+    {
+        for (sLine += 2; *sLine != '\0' && ir_raw_count < IR_RAW_SIZE; sLine++)
+        {
+            value = (*sLine <= '9') ? *sLine - '0' : (*sLine | 0x20) - 'a' + 10;
+            if (value < ir_table_count) {
+                ir_raw[ir_raw_count++] = ir_table[value];
+            }
+        }
+    }
+    else if (strcmp(sLine, "end") == 0)
+    {
+        FMT_Uint(FMT_Text(textToWrite, (ir_raw_count == ir_load_expected) ? "loaded " : "load error "),
+                 ir_raw_count);
+        USART0_TX_String(textToWrite);
+    }
+    else {
+        USART0_TX_String("unknown command");
+    }
+}
+
+// a loaded duration above 16 bits (Timer4 ticks): reported, and the count no longer matches "raw <n>"
+void IR_LoadRangeError(unsigned long value)
+{
+    FMT_Ulong(FMT_Text(textToWrite, "range error "), value);
+    USART0_TX_String(textToWrite);
+    ir_load_expected = IR_RAW_SIZE + 1;
+}
+
+// queue a decoded frame (ISR context)
+void IR_Push(unsigned int address, unsigned char command, unsigned char repeat)
+{
+    unsigned char next = (ir_event_head + 1) & IR_EVENT_MASK;
+    if (next == ir_event_tail)
+    {
+        ir_events_dropped++;
+        return;
+    }
+    ir_events[ir_event_head].address = address;
+    ir_events[ir_event_head].command = command;
+    ir_events[ir_event_head].repeat = repeat;
+    ir_event_head = next;
+}
+
+// Copy the oldest decoded frame, returns 0 if there is none
+unsigned char IR_GetEvent(IR_Event* pEvent)
+{
+    if (ir_event_tail == ir_event_head) {
+        return 0;
+    }
+    pEvent->address = ir_events[ir_event_tail].address;
+    pEvent->command = ir_events[ir_event_tail].command;
+    pEvent->repeat = ir_events[ir_event_tail].repeat;
+    ir_event_tail = (ir_event_tail + 1) & IR_EVENT_MASK;
+    return 1;
 }
@@ -0,0 +1,97 @@
+/*
+  LCD_FrameBuffer_2560.h
+
+  Shadow framebuffer for the HD44780 LCD (uses LCD_Lib_2560.h and its geometry).
+  Callers only write characters into SRAM (LCD_FB_WriteString / LCD_FB_WriteChar),
+  LCD_FB_Flush() then compares the buffer with what the display is showing and
+  sends only the cells that changed. The cursor is moved with a single
+  'Set DDRAM Address' command when the next changed cell is not the one the
+  cursor is already on, so an unchanged screen costs zero bus writes and
+  there is no LCD_Clear() flicker.
+*/
+
+#ifndef LCD_FRAMEBUFFER_2560_H
+#define LCD_FRAMEBUFFER_2560_H
+
+#define LCD_FB_ROWS     LCD_DisplayHeight_ROWS
+#define LCD_FB_COLS     LCD_DisplayWidth_CHARS
+
+unsigned char lcd_fb[LCD_FB_ROWS][LCD_FB_COLS];        // what the callers want to show
+unsigned char lcd_fb_shown[LCD_FB_ROWS][LCD_FB_COLS];  // what the LCD is showing
+
+// bus statistics (commands + data bytes written to the LCD)
+unsigned int  lcd_fb_bytes_last = 0;    // bytes sent by the last flush
+unsigned long lcd_fb_bytes_total = 0;   // bytes sent by all flushes
+unsigned int  lcd_fb_flushes = 0;       // number of flushes
+
+void LCD_FB_Init();
+void LCD_FB_Clear();
+void LCD_FB_WriteChar(unsigned char iColumnPosition, unsigned char iRowPosition, unsigned char cValue);
+void LCD_FB_WriteString(unsigned char iColumnPosition, unsigned char iRowPosition, char Text[]);
+unsigned int LCD_FB_Flush();
+
+// Clear the display once, after this the buffer and the LCD agree (all spaces)
+void LCD_FB_Init()
+{
+    LCD_Clear();
+    memset(lcd_fb_shown, ' ', sizeof(lcd_fb_shown));
+    LCD_FB_Clear();
+}
+
+// Fill the buffer with spaces (nothing is sent to the LCD)
+void LCD_FB_Clear()
+{
+    memset(lcd_fb, ' ', sizeof(lcd_fb));
+}
+
+void LCD_FB_WriteChar(unsigned char iColumnPosition, unsigned char iRowPosition, unsigned char cValue)
+{
+    if (iColumnPosition < LCD_FB_COLS && iRowPosition < LCD_FB_ROWS) {
+        lcd_fb[iRowPosition][iColumnPosition] = cValue;
+    }
+}
+
+// Text is clipped at the end of the row
+void LCD_FB_WriteString(unsigned char iColumnPosition, unsigned char iRowPosition, char Text[])
+{
+    while (*Text != '\0' && iColumnPosition < LCD_FB_COLS)
+    {
+        LCD_FB_WriteChar(iColumnPosition++, iRowPosition, *Text++);
+    }
+}
+
+// Send the changed cells to the LCD, returns the number of bus writes
+unsigned int LCD_FB_Flush()
+{
+    unsigned int iBytes = 0;
+    unsigned char iRow, iCol;
+    bool bCursorValid;
+
+    for (iRow = 0; iRow < LCD_FB_ROWS; iRow++)
+    {
+        bCursorValid = false; // cursor position unknown at the start of each row
+        for (iCol = 0; iCol < LCD_FB_COLS; iCol++)
+        {
+            if (lcd_fb[iRow][iCol] == lcd_fb_shown[iRow][iCol])
+            {
+                bCursorValid = false;
+                continue;
+            }
+            if (!bCursorValid)
+            {
+                LCD_SetCursorPosition(iCol, iRow); // one 'Set DDRAM Address' command
+                iBytes++;
+                bCursorValid = true;
+            }
+            LCD_Write_CommandOrData(false, lcd_fb[iRow][iCol]); // cursor moves on by itself
+            lcd_fb_shown[iRow][iCol] = lcd_fb[iRow][iCol];
+            iBytes++;
+        }
+    }
+    lcd_fb_bytes_last = iBytes;
+    lcd_fb_bytes_total += iBytes;
+    lcd_fb_flushes++;
+    return iBytes;
+}
+
+#endif
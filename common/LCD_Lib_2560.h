@@ -27,17 +27,60 @@
   A    <-> 5V via 1kohm (A = Backlight LED anode)
   K    <-> GND  (K = Backlight LED cathode)
   ----------------------------
+
+  Command/data queue:
+  At start-up every write waits on the busy flag and goes straight to the
+  LCD (synchronous mode). After LCD_StartAsync() the LCD functions only put
+  the byte in lcd_queue and return; LCD_Service(), called from the main loop
+  idle hook, sends queued bytes whenever the busy flag (PA7) reads clear.
+  Nothing blocks for the 1.5-2 ms a clear or home takes.
+  LCD_Service() must run in the same context as the writers (not in an ISR).
 */
 
+#ifndef LCD_LIB_2560_H
+#define LCD_LIB_2560_H
+
 #include <stdbool.h>
 #include <string.h>
 
+// Module geometry: 16x2 (default), 20x4, 40x2, ... (define before including to change)
+#ifndef LCD_DisplayWidth_CHARS
 #define LCD_DisplayWidth_CHARS  16
+#endif
+#ifndef LCD_DisplayHeight_ROWS
+#define LCD_DisplayHeight_ROWS  2
+#endif
 #define LCD_anodePin            PK3
 
+// DDRAM address of the first character of each row. Row 1 always starts at 0x40,
+// on 4-row modules rows 2 and 3 continue rows 0 and 1 (e.g. 0x14 / 0x54 on a 20x4).
+#if LCD_DisplayHeight_ROWS == 4
+const unsigned char lcd_row_address[4] = {0x00, 0x40, LCD_DisplayWidth_CHARS, 0x40 + LCD_DisplayWidth_CHARS};
+#elif LCD_DisplayHeight_ROWS == 2
+const unsigned char lcd_row_address[2] = {0x00, 0x40};
+#else
+const unsigned char lcd_row_address[1] = {0x00};
+#endif
+
+#define LCD_QUEUE_SIZE          64  // power of two (<= 256)
+#define LCD_QUEUE_MASK          (LCD_QUEUE_SIZE - 1)
+#define LCD_QUEUE_DATA          0x100   // queue entry flag: data (RS high), otherwise command
+#define LCD_SERVICE_BURST       4   // max bytes sent per LCD_Service() call
+
+unsigned int  lcd_queue[LCD_QUEUE_SIZE];    // bits 7:0 value, bit 8 LCD_QUEUE_DATA
+unsigned char lcd_queue_head = 0, lcd_queue_tail = 0;
+unsigned char lcd_queue_high_water = 0;     // deepest the queue has been
+unsigned int  lcd_queue_full_stalls = 0;    // writes that had to wait for a full queue
+bool lcd_async = false;                     // false = synchronous (early boot)
+
 // Function declarations
 void LCD_Write_CommandOrData(bool bCommand /*true = Command, false = Data*/, unsigned char DataOrCommand_Value);
+void LCD_Bus_Write(bool bCommand, unsigned char DataOrCommand_Value);
+bool LCD_Busy();
 void LCD_Wait();
+void LCD_StartAsync();
+void LCD_Service();
+unsigned char LCD_QueueDepth();
 
 /* bTwoLine: false = 1-line mode, true = 2-line mode*/
 /* bLargeFont: false = 5*8pixels, true = 5*11 pixels*/
@@ -55,11 +98,37 @@ void LCD_ShiftDisplay(bool bShiftDisplayON /*true=On, false=OFF*/, bool bDirecti
 void LCD_SetCursorPosition(unsigned char iColumnPosition /*0-40 */, unsigned char iRowPosition);
 
 void LCD_WriteString(char Text[]);
+void LCD_WriteStringAt(unsigned char iColumnPosition, unsigned char iRowPosition, char Text[]);
 
 void LCD_Write_CommandOrData(bool bCommand /*true=Command, false=Data*/, unsigned char DataOrCommand_Value)
 {
-    LCD_Wait(); // Wait if LCD device is busy
-    
+    unsigned char next, depth;
+
+    if (!lcd_async)
+    {
+        LCD_Wait(); // Wait if LCD device is busy
+        LCD_Bus_Write(bCommand, DataOrCommand_Value);
+        return;
+    }
+    next = (lcd_queue_head + 1) & LCD_QUEUE_MASK;
+    if (next == lcd_queue_tail)
+    {
+        // queue full: send the oldest byte the slow way to make room
+        lcd_queue_full_stalls++;
+        LCD_Wait();
+        LCD_Service();
+    }
+    lcd_queue[lcd_queue_head] = (bCommand ? 0 : LCD_QUEUE_DATA) | DataOrCommand_Value;
+    lcd_queue_head = next;
+    depth = LCD_QueueDepth();
+    if (depth > lcd_queue_high_water) {
+        lcd_queue_high_water = depth;
+    }
+}
+
+// Write one byte to the LCD bus, the caller has checked the busy flag
+void LCD_Bus_Write(bool bCommand, unsigned char DataOrCommand_Value)
+{
     // The access sequence is as follows:
     // 1. Set command lines as necessary:
     if(true == bCommand)
@@ -80,21 +149,51 @@ void LCD_Write_CommandOrData(bool bCommand /*true=Command, false=Data*/, unsigne
     PORTG &= ~(1 << PG2); // Clear LCD Enable (PortG bit2)
 }
 
-void LCD_Wait()     // Check if the LCD device is busy, if so wait
-{                   // Busy flag is mapped to data bit 6, so read as port A bit 6
+bool LCD_Busy()     // Read the busy flag once
+{                   // Busy flag is data bit 7, so read as port A bit 7
+    unsigned char PINA_value;
     PORTG &= ~(1<<PG0); // Clear Register Select for command mode (PortG bit0)
     PORTG |= (1<<PG1);  // Set Read(H)/Write(L) (PortG bit1)
     DDRA = 0x00;        // Configure PortA direction for Input (so busy flag can be read)
-    
-    unsigned char PINA_value = 0;
-    while(PINA_value & 0x80);   // Wait here until busy flag is cleared
+
+    PORTG |= (1<<PG2);  // Set LCD Enable (PortG bit2)
+    PINA_value = PINA;
+    PORTG &= ~(1<<PG2); // Clear LCD Enable (PortG bit2)
+    return (PINA_value & 0x80) != 0;
+}
+
+void LCD_Wait()     // Check if the LCD device is busy, if so wait
+{
+    while (LCD_Busy());   // Wait here until busy flag is cleared
+}
+
+// Switch from synchronous writes to the queue (call once the main loop runs LCD_Service)
+void LCD_StartAsync()
+{
+    lcd_queue_head = lcd_queue_tail = 0;
+    lcd_async = true;
+}
+
+// Idle hook: send queued bytes while the LCD is not busy, never waits
+void LCD_Service()
+{
+    unsigned int entry;
+    for (unsigned char i = 0; i < LCD_SERVICE_BURST; i++)
     {
-        PORTG |= (1<<PG2);  // Set LCD Enable (PortG bit2)
-        PINA_value = PINA;
-        PORTG &= ~(1<<PG2); // Clear LCD Enable (PortG bit2)
+        if (lcd_queue_head == lcd_queue_tail || LCD_Busy()) {
+            return;
+        }
+        entry = lcd_queue[lcd_queue_tail];
+        lcd_queue_tail = (lcd_queue_tail + 1) & LCD_QUEUE_MASK;
+        LCD_Bus_Write(!(entry & LCD_QUEUE_DATA), (unsigned char)entry);
     }
 }
 
+unsigned char LCD_QueueDepth()
+{
+    return (lcd_queue_head - lcd_queue_tail) & LCD_QUEUE_MASK;
+}
+
 /* bTwoLine: false = 1 line mode, true =  2 line mode */
 /* bLargeFont: false = 5*8pixels, true = 5*11 pixels */
 void LCD_Initilise(bool bTwoLine, bool bLargeFont)
@@ -157,14 +256,12 @@ void LCD_Display_ON_OFF(bool bDisplayON /*true = ON, false = OFF*/, bool bCursor
 
 void LCD_Clear()  // Clear the LCD display
 {
-    LCD_Write_CommandOrData(true /*true=Command, false=Data*/, 0x01);
-    _delay_ms(2); // Enforce delay for specific LCD operations to complete
+    LCD_Write_CommandOrData(true /*true=Command, false=Data*/, 0x01); // ~1.5 ms, covered by the busy flag
 }
 
 void LCD_Home() // Set the cursor to the 'home' position
 {
-    LCD_Write_CommandOrData(true /*true = Command, false = Data*/, 0x02);
-    _delay_ms(2);   // Enforce delay for specific LCD operations to complete
+    LCD_Write_CommandOrData(true /*true = Command, false = Data*/, 0x02); // ~1.5 ms, covered by the busy flag
 }
 
 void LCD_WriteChar(unsigned char cValue)
@@ -201,24 +298,27 @@ void LCD_ShiftDisplay(bool bShiftDisplayON /*true=On, false=OFF*/, bool bDirecti
     }
 }
 
-/* iColumnPosition: 0 - 40 */
-/* iRowPosition: 0 for top row, 1 for bottom row */
+/* iColumnPosition: 0 - (LCD_DisplayWidth_CHARS-1) */
+/* iRowPosition: 0 for top row, 1 for the next row, ... */
 void LCD_SetCursorPosition(unsigned char iColumnPosition, unsigned char iRowPosition)
 {
-    // Cursor position is achieved by repeatedly shifting from the home position.
-    // In 2-line mode, the beginning of the second line is the 41st position (from home position)
-    unsigned char iTargetPosition = (40*iRowPosition) + iColumnPosition;
-    LCD_Home();
-    for(unsigned char iPos = 0; iPos<iTargetPosition; iPos++)
-    {
-        LCD_Write_CommandOrData(true /*true = Command, false = Data*/, 0b00010100); // Shift cursor left 1 place
-    }
+    // One 'Set DDRAM Address' command (bit 7 high + 7-bit address) for any position.
+    // (Shifting from home took 1 home command (1.5 ms) + up to 55 cursor shifts.)
+    LCD_Write_CommandOrData(true /*true = Command, false = Data*/, 0x80 | (lcd_row_address[iRowPosition] + iColumnPosition));
 }
 
 void LCD_WriteString(char Text[])
 {
-    for(unsigned char iIndex = 0; iIndex<strlen(Text); iIndex++)
+    while (*Text != '\0')
     {
-        LCD_WriteChar(Text[iIndex]);
+        LCD_WriteChar(*Text++);
     }
 }
+
+void LCD_WriteStringAt(unsigned char iColumnPosition, unsigned char iRowPosition, char Text[])
+{
+    LCD_SetCursorPosition(iColumnPosition, iRowPosition);
+    LCD_WriteString(Text);
+}
+
+#endif
@@ -0,0 +1,201 @@
+/*
+  format.h
+
+  Integer to text without printf: decimal (unsigned / signed, 16 and 32
+  bit), fixed-width hex and fixed point. Every function writes into the
+  caller's buffer, adds the terminating 0 and returns a pointer to it, so a
+  line is built by chaining the calls:
+    char sLine[32], *p;
+    p = FMT_Uint(sLine, i);             // "%u: %u"
+    p = FMT_Text(p, ": ");
+    FMT_Uint(p, count);
+  No varargs, no format string to parse, nothing allocated.
+  - - - - - - - - - - - - - - - - -
+  16-bit decimal: two digits per step from fmt_pairs[] ("00" .. "99", in
+  flash), the division by 100 is a multiply and shift. 32-bit values above
+  65535 take one 32-bit division by 10000 per 4 digits, then the 16-bit path.
+  Buffer sizes (with the 0): FMT_Uint 6, FMT_Int 7, FMT_Ulong 11, FMT_Long 12,
+  FMT_Hex digits + 1, FMT_Fixed 14 up to 10 decimals, decimals + 4 above
+  ("-0." and a zero-padded fraction). host/test_format.c checks every
+  function against snprintf (make test).
+*/
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <avr/pgmspace.h>
+
+// v / 100 for any 16-bit v: (v / 4) * (2^17 / 25 rounded up) >> 17, exact up to 65535
+#define FMT_DIV100(v)   ((unsigned int)(((unsigned long)((v) >> 2) * 5243U) >> 17))
+
+const char fmt_pairs[200] PROGMEM =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829"
+    "30313233343536373839" "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879" "80818283848586878889"
+    "90919293949596979899";
+
+char* FMT_Uint(char* p, unsigned int v);
+char* FMT_Int(char* p, int v);
+char* FMT_Ulong(char* p, unsigned long v);
+char* FMT_Long(char* p, long v);
+char* FMT_Hex(char* p, unsigned long v, unsigned char digits);
+char* FMT_Fixed(char* p, long v, unsigned char decimals);
+char* FMT_Text(char* p, const char* s);
+
+// two digits of v (0-99) at p
+static inline void FMT_Pair(char* p, unsigned char v)
+{
+    p[0] = pgm_read_byte(&fmt_pairs[2 * v]);
+    p[1] = pgm_read_byte(&fmt_pairs[2 * v + 1]);
+}
+
+// all digits of v, right to left, ending just before pEnd; returns the first digit
+static inline char* FMT_Digits(char* pEnd, unsigned int v)
+{
+    unsigned int q;
+
+    while (v >= 100)
+    {
+        q = FMT_DIV100(v);
+        pEnd -= 2;
+        FMT_Pair(pEnd, v - q * 100);
+        v = q;
+    }
+    if (v >= 10)
+    {
+        pEnd -= 2;
+        FMT_Pair(pEnd, v);
+    }
+    else {
+        *--pEnd = '0' + v;
+    }
+    return pEnd;
+}
+
+// "%u"
+char* FMT_Uint(char* p, unsigned int v)
+{
+    // the length first, then the digits go straight to their place
+    p += (v >= 10000) ? 5 : (v >= 1000) ? 4 : (v >= 100) ? 3 : (v >= 10) ? 2 : 1;
+    *p = '\0';
+    FMT_Digits(p, v);
+    return p;
+}
+
+// "%d"
+char* FMT_Int(char* p, int v)
+{
+    if (v < 0)
+    {
+        *p++ = '-';
+        return FMT_Uint(p, -(unsigned int)v);
+    }
+    return FMT_Uint(p, v);
+}
+
+// "%lu"
+char* FMT_Ulong(char* p, unsigned long v)
+{
+    char digits[10];
+    char *pFirst = digits + sizeof(digits);
+    unsigned long q;
+    unsigned int r;
+
+    if (v <= 0xFFFF) {
+        return FMT_Uint(p, v);
+    }
+    while (v > 0xFFFF)
+    {
+        q = v / 10000;
+        r = v - q * 10000;
+        pFirst -= 4;
+        FMT_Pair(pFirst, FMT_DIV100(r));
+        FMT_Pair(pFirst + 2, r - FMT_DIV100(r) * 100);
+        v = q;
+    }
+    pFirst = FMT_Digits(pFirst, v);
+    while (pFirst < digits + sizeof(digits)) {
+        *p++ = *pFirst++;
+    }
+    *p = '\0';
+    return p;
+}
+
+// "%ld"
+char* FMT_Long(char* p, long v)
+{
+    if (v < 0)
+    {
+        *p++ = '-';
+        return FMT_Ulong(p, -(unsigned long)v);
+    }
+    return FMT_Ulong(p, v);
+}
+
+// "%0<digits>lX": the low 'digits' hex digits of v, upper case
+char* FMT_Hex(char* p, unsigned long v, unsigned char digits)
+{
+    unsigned char nibble;
+
+    p += digits;
+    *p = '\0';
+    for (char *q = p; digits > 0; digits--)
+    {
+        nibble = v & 0x0F;
+        *--q = (nibble < 10) ? '0' + nibble : 'A' - 10 + nibble;
+        v >>= 4;
+    }
+    return p;
+}
+
+// v / 10^decimals with 'decimals' places, e.g. FMT_Fixed(p, -1205, 3) = "-1.205"
+char* FMT_Fixed(char* p, long v, unsigned char decimals)
+{
+    char digits[11];
+    char *pEnd, *pDigit = digits;
+    unsigned char length;
+    unsigned long u = v;
+
+    if (v < 0)
+    {
+        *p++ = '-';
+        u = -u;
+    }
+    pEnd = FMT_Ulong(digits, u);
+    length = pEnd - digits;
+    if (length <= decimals) // "0." and the leading zeros of the fraction
+    {
+        *p++ = '0';
+        *p++ = '.';
+        for (unsigned char i = length; i < decimals; i++) {
+            *p++ = '0';
+        }
+        decimals = length;
+    }
+    else
+    {
+        for (unsigned char i = length - decimals; i > 0; i--) {
+            *p++ = *pDigit++;
+        }
+        if (decimals > 0) {
+            *p++ = '.';
+        }
+    }
+    while (decimals-- > 0) {
+        *p++ = *pDigit++;
+    }
+    *p = '\0';
+    return p;
+}
+
+// "%s"
+char* FMT_Text(char* p, const char* s)
+{
+    while (*s != '\0') {
+        *p++ = *s++;
+    }
+    *p = '\0';
+    return p;
+}
+
+#endif
@@ -0,0 +1,215 @@
+/*
+  keypad.h
+  Updated: Victor Hansen, 06.11.20
+
+  Based on: Lab 3 - keypad
+  and KEYPAD_LEDs_1281_C by Richard Anthony - 17th October 2013
+  -------------------------------
+  Keypad    <-> Arduino Mega
+  P0 is the top-most pin (almost on the same row as S1, S2 ..)
+  Px is the bottom-most pin (almost on the same row as S9, S10 ..)
+  - - - - - - - - - - - -
+  P0  <-> PC0
+  P1  <-> PC1
+  P2  <-> PC2
+  P3  <-> PC3
+  P4  <-> PC7
+  P5  <-> PC6
+  P6  <-> PC5
+  P7  <-> PC4
+  - - - - - - - - - - - -
+
+  The matrix is scanned by TIMER2_COMPA_vect every KEYPAD_SCAN_MS, the main
+  program never touches PORTC. (PC0-PC3 have no pin-change interrupt on the
+  ATmega2560, so a periodic scan is used.)
+  Every key has its own integrator: +1 per scan while the key reads pressed,
+  -1 while it reads released. A key only changes state when its integrator
+  reaches KEYPAD_DEBOUNCE_SCANS (pressed) or 0 (released), and each change is
+  queued as an event. keypad_state is a bitmap of all 16 debounced keys, so
+  simultaneous presses are reported as separate events.
+  (Without diodes, 3 keys on the corners of a rectangle also read the 4th.)
+  - - - - - - - - - - - -
+  Usage:
+    KEYPAD_Init();
+    while ((Event = KEYPAD_GetEvent()) != NoKey) {
+        if (!(Event & KEYPAD_RELEASE)) { ... key (Event & KEYPAD_KEY_MASK) pressed ... }
+    }
+*/
+
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "profiler_2560.h"
+
+/* Bits 4-7 pulled low depending on row being scanned,
+   bits 0-3 related to the columns (pull-ups) remain high at all times. */
+// Row0 = bit 7, Row1 = bit 6, Row2 = bit 5, Row3 = bit 4.
+#define ScanKeypadRow0 0b01111111
+#define ScanKeypadRow1 0b10111111
+#define ScanKeypadRow2 0b11011111
+#define ScanKeypadRow3 0b11101111
+
+// Bits 3:0 connect to keypad Columns
+// Col0 = bit 3, Col1 = bit 2, Col2 = bit 1, Col3 = bit0
+#define KeypadMaskColumns 0b11110000
+#define KeypadMaskColumn0 0b00001000
+#define KeypadMaskColumn1 0b00000100
+#define KeypadMaskColumn2 0b00000010
+#define KeypadMaskColumn3 0b00000001
+
+#define NoKey       0xFF
+#define NUM_rows    4
+#define NUM_keys    16
+
+#define KEYPAD_SCAN_MS          5   // Timer2 scan period
+#define KEYPAD_DEBOUNCE_SCANS   4   // 4 x 5 ms stable before a change is reported
+// Timer2 prescaler: 64 while the scan fits in 8 bits (up to 3.2 MHz), else 256 or 1024
+#if F_CPU / 64 * KEYPAD_SCAN_MS / 1000UL <= 256
+#define KEYPAD_SCAN_PRESCALER   64
+#define KEYPAD_SCAN_CS          (1<<CS22)
+#elif F_CPU / 256 * KEYPAD_SCAN_MS / 1000UL <= 256
+#define KEYPAD_SCAN_PRESCALER   256
+#define KEYPAD_SCAN_CS          (1<<CS22 | 1<<CS21)
+#else
+#define KEYPAD_SCAN_PRESCALER   1024
+#define KEYPAD_SCAN_CS          (1<<CS22 | 1<<CS21 | 1<<CS20)
+#endif
+// Timer2 counts per scan (78 at 1 MHz / 64 and at 16 MHz / 1024), must fit in 8 bits
+#define KEYPAD_SCAN_COUNTS      (F_CPU / KEYPAD_SCAN_PRESCALER * KEYPAD_SCAN_MS / 1000UL)
+#if KEYPAD_SCAN_COUNTS > 256
+#error "keypad.h: KEYPAD_SCAN_MS is too long for Timer2 (OCR2A is 8 bits)"
+#endif
+
+// event = key number (1-16, S1 = 1) | KEYPAD_RELEASE for a release
+#define KEYPAD_RELEASE          0x80
+#define KEYPAD_KEY_MASK         0x1F
+#define KEYPAD_EVENT_SIZE       16  // power of two
+#define KEYPAD_EVENT_MASK       (KEYPAD_EVENT_SIZE - 1)
+
+// Table-driven scan: row drive patterns, and column pin -> column number.
+// Matrix bit = row * 4 + column, key number = bit + 1 (S1 = 1 .. S16 = 16)
+const unsigned char keypad_row[NUM_rows] = {ScanKeypadRow0, ScanKeypadRow1, ScanKeypadRow2, ScanKeypadRow3};
+const unsigned char keypad_column[4] = {3, 2, 1, 0}; // PINC bit 0 = Col3 .. bit 3 = Col0
+
+volatile unsigned int keypad_state = 0;             // debounced matrix, bit n = key n+1 pressed
+unsigned char keypad_integrator[NUM_keys];          // 0 .. KEYPAD_DEBOUNCE_SCANS (ISR only)
+volatile unsigned char keypad_events[KEYPAD_EVENT_SIZE];
+volatile unsigned char keypad_event_head = 0;       // written by the ISR
+volatile unsigned char keypad_event_tail = 0;       // written by KEYPAD_GetEvent()
+volatile unsigned char keypad_events_dropped = 0;   // queue full
+
+void KEYPAD_Init();
+unsigned int KEYPAD_ScanMatrix();
+unsigned char KEYPAD_GetEvent();
+unsigned int KEYPAD_State();
+
+void KEYPAD_Init()
+{
+    DDRC = 0xF0; // Row pins output / Column pins input
+    PORTC = 0x0F; // Set pull-ups on column pins (so they read '1' when no key is pressed)
+
+    TCCR2A = (1<<WGM21);            // CTC mode, TOP = OCR2A
+    TCCR2B = KEYPAD_SCAN_CS;        // prescaler = KEYPAD_SCAN_PRESCALER
+    OCR2A  = KEYPAD_SCAN_COUNTS - 1;
+    TCNT2  = 0x00;
+    TIMSK2 = (1<<OCIE2A);           // scan interrupt
+}
+
+// Raw (not debounced) matrix: bit n set = key n+1 reads pressed
+unsigned int KEYPAD_ScanMatrix()
+{
+    unsigned int Matrix = 0;
+    unsigned char ColumnPinsValue;
+
+    for (unsigned char i = 0; i < NUM_rows; i++)
+    {
+        PORTC = keypad_row[i]; // Set Row 'i' low, and the other Rows high
+        asm volatile ("nop");  // let the column inputs pass the input synchroniser
+        ColumnPinsValue = ~(PINC | KeypadMaskColumns); // '1' in any column position means key pressed
+        for (unsigned char pin = 0; pin < 4; pin++)
+        {
+            if (ColumnPinsValue & (1<<pin)) {
+                Matrix |= 1U << (i * 4 + keypad_column[pin]);
+            }
+        }
+    }
+    PORTC = 0x0F; // idle: all rows low, so any key press pulls a column low
+    return Matrix;
+}
+
+// Scan the matrix and run the per-key integrators
+ISR(TIMER2_COMPA_vect)
+{
+    PROFILER_ENTER(PROFILER_TIMER2_COMPA, TCNT2 * KEYPAD_SCAN_PRESCALER); // counts since the compare match
+    unsigned int Matrix = KEYPAD_ScanMatrix();
+    unsigned int State = keypad_state;
+    unsigned char Event = 0, next;
+
+    for (unsigned char key = 0; key < NUM_keys; key++)
+    {
+        if (Matrix & (1U<<key))
+        {
+            if (keypad_integrator[key] < KEYPAD_DEBOUNCE_SCANS) {
+                keypad_integrator[key]++;
+            }
+            if (keypad_integrator[key] == KEYPAD_DEBOUNCE_SCANS && !(State & (1U<<key)))
+            {
+                State |= (1U<<key);
+                Event = key + 1;
+            }
+        }
+        else
+        {
+            if (keypad_integrator[key] > 0) {
+                keypad_integrator[key]--;
+            }
+            if (keypad_integrator[key] == 0 && (State & (1U<<key)))
+            {
+                State &= ~(1U<<key);
+                Event = (key + 1) | KEYPAD_RELEASE;
+            }
+        }
+        if (Event)
+        {
+            next = (keypad_event_head + 1) & KEYPAD_EVENT_MASK;
+            if (next == keypad_event_tail) {
+                keypad_events_dropped++;
+            }
+            else
+            {
+                keypad_events[keypad_event_head] = Event;
+                keypad_event_head = next;
+            }
+            Event = 0;
+        }
+    }
+    keypad_state = State;
+}
+
+// Next key event, NoKey if there is none (never blocks)
+unsigned char KEYPAD_GetEvent()
+{
+    unsigned char Event;
+    if (keypad_event_tail == keypad_event_head) {
+        return NoKey;
+    }
+    Event = keypad_events[keypad_event_tail];
+    keypad_event_tail = (keypad_event_tail + 1) & KEYPAD_EVENT_MASK;
+    return Event;
+}
+
+// Debounced matrix, bit n set = key n+1 held down
+unsigned int KEYPAD_State()
+{
+    unsigned int State;
+    unsigned char sreg = SREG; // 16-bit read must not be split by the scan ISR
+    cli();
+    State = keypad_state;
+    SREG = sreg;
+    return State;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+  power_2560.h
+
+  Sleep and peripheral clock gating for the ATmega2560 firmwares.
+  POWER_Init() switches off the clocks of the peripherals a firmware never
+  uses (PRR0 / PRR1). POWER_Sleep() is called from the main loop when there
+  is no work left and picks the deepest sleep mode the running peripherals
+  allow:
+  - - - - - - - - - - - - - - - - -
+  Mode            chosen when                           wake-up (interrupt response not included)
+  Idle            a timer on the I/O clock runs, or     4 CK (4 us at 1 MHz, 0.25 us at 16 MHz)
+                  a USART is enabled (RX needs clkIO
+                  to see a start bit)
+  ADC Noise Red.  only a conversion is in progress      4 CK
+  Power-save      only Timer2 runs, from its own        oscillator start-up (fuses) + 4 CK
+                  32 kHz crystal (AS2)
+  Power-down      nothing runs                          oscillator start-up (fuses) + 4 CK
+  - - - - - - - - - - - - - - - - -
+  Oscillator start-up from Power-save / Power-down: 6 CK for the internal RC
+  (1 MHz, 4.1 ms more with the slow SUT fuses), 16K CK = 1 ms for the 16 MHz
+  crystal on the Mega. The interrupt response adds 5 CK plus the ISR prologue.
+
+  The measured wake-to-handler time is kept per mode: an ISR that can end a
+  sleep reports how long ago its event happened with POWER_WAKE_SAMPLE(us)
+  (e.g. the timer count since the compare match), the first one after a
+  sleep is recorded in power_wake_us_max[]. The numbers show whether a
+  mode delays the response to a sonar echo, IR edge or ADC sample.
+  - - - - - - - - - - - - - - - - -
+  Usage (the 'no work' check and the sleep must not be split by an ISR):
+    cli();
+    if (nothing to do) {
+        POWER_Sleep();  // enables interrupts again
+    }
+    sei();
+*/
+
+#ifndef POWER_2560_H
+#define POWER_2560_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#define POWER_IDLE      0
+#define POWER_ADC       1
+#define POWER_SAVE      2
+#define POWER_DOWN      3
+#define POWER_MODES     4
+
+// a timer needs the I/O clock while its clock select bits (CSn2:0) are not 0
+#define POWER_TIMER_ON(tccrb)   ((tccrb) & 0x07)
+
+const unsigned char power_sleep_mode[POWER_MODES] =
+{
+    SLEEP_MODE_IDLE, SLEEP_MODE_ADC, SLEEP_MODE_PWR_SAVE, SLEEP_MODE_PWR_DOWN
+};
+
+volatile unsigned char power_asleep = 0;            // set until the first ISR after a sleep
+volatile unsigned char power_mode = POWER_IDLE;     // mode of the last sleep
+unsigned int power_sleeps[POWER_MODES];             // sleeps per mode
+volatile unsigned int power_wake_us_max[POWER_MODES];   // longest wake-to-handler time per mode
+
+// first ISR after a sleep: us = time from its event to here
+#define POWER_WAKE_SAMPLE(us) do { \
+        if (power_asleep) { \
+            unsigned int power_us = (us); \
+            power_asleep = 0; \
+            if (power_us > power_wake_us_max[power_mode]) { \
+                power_wake_us_max[power_mode] = power_us; \
+            } \
+        } \
+    } while (0)
+
+void POWER_Init(unsigned char iOff0, unsigned char iOff1);
+unsigned char POWER_DeepestMode();
+void POWER_Sleep();
+
+// Stop the clocks of unused peripherals, iOff0 / iOff1 = PRR0 / PRR1 bits
+void POWER_Init(unsigned char iOff0, unsigned char iOff1)
+{
+    if (iOff0 & (1<<PRADC)) {
+        ADCSRA &= ~(1<<ADEN); // the ADC must be disabled before its clock is stopped
+    }
+    ACSR |= (1<<ACD); // analog comparator off (not used by any of the firmwares)
+    PRR0 = iOff0;
+    PRR1 = iOff1;
+}
+
+// Deepest sleep mode that keeps every running peripheral working
+unsigned char POWER_DeepestMode()
+{
+    if ((!(PRR0 & (1<<PRTIM0)) && POWER_TIMER_ON(TCCR0B))
+        || (!(PRR0 & (1<<PRTIM1)) && POWER_TIMER_ON(TCCR1B))
+        || (!(PRR0 & (1<<PRTIM2)) && POWER_TIMER_ON(TCCR2B) && !(ASSR & (1<<AS2)))
+        || (!(PRR1 & (1<<PRTIM3)) && POWER_TIMER_ON(TCCR3B))
+        || (!(PRR1 & (1<<PRTIM4)) && POWER_TIMER_ON(TCCR4B))
+        || (!(PRR1 & (1<<PRTIM5)) && POWER_TIMER_ON(TCCR5B))
+        || (!(PRR0 & (1<<PRUSART0)) && (UCSR0B & (1<<RXEN0 | 1<<TXEN0)))
+        || (!(PRR1 & (1<<PRUSART1)) && (UCSR1B & (1<<RXEN0 | 1<<TXEN0)))
+        || (!(PRR1 & (1<<PRUSART2)) && (UCSR2B & (1<<RXEN0 | 1<<TXEN0)))
+        || (!(PRR1 & (1<<PRUSART3)) && (UCSR3B & (1<<RXEN0 | 1<<TXEN0)))
+        || (!(PRR0 & (1<<PRSPI)) && (SPCR & (1<<SPE)))
+        || (!(PRR0 & (1<<PRTWI)) && (TWCR & (1<<TWEN)))) {
+        return POWER_IDLE;
+    }
+    if (!(PRR0 & (1<<PRADC)) && (ADCSRA & (1<<ADSC))) {
+        return POWER_ADC; // entering this mode with the ADC idle would start a conversion
+    }
+    if (!(PRR0 & (1<<PRTIM2)) && POWER_TIMER_ON(TCCR2B)) {
+        return POWER_SAVE; // Timer2 on its asynchronous crystal
+    }
+    return POWER_DOWN;
+}
+
+// Sleep until the next interrupt. Call with interrupts disabled, returns with them enabled.
+void POWER_Sleep()
+{
+    unsigned char mode = POWER_DeepestMode();
+
+    set_sleep_mode(power_sleep_mode[mode]);
+    power_mode = mode;
+    power_asleep = 1;
+    power_sleeps[mode]++;
+    sleep_enable();
+    sei();          // the instruction after SEI runs before any pending interrupt: no lost wake-up
+    sleep_cpu();
+    sleep_disable();
+    power_asleep = 0;   // woken by an ISR that does not sample the latency
+}
+
+#endif
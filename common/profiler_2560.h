@@ -0,0 +1,259 @@
+/*
+  profiler_2560.h
+
+  ISR execution time and entry latency, measured on the target.
+  Off unless the firmware is built with PROFILER defined:
+    make alarm EXTRA_CFLAGS=-DPROFILER
+  Without it PROFILER_ENTER() and PROFILER_Init() expand to nothing and
+  there is no table, no timer and no code.
+
+  The firmware picks a 16-bit timer it does not use (#define PROFILER_TIMER 5
+  before the first include of this header). PROFILER_Init() runs it freely
+  without prescaler, so one tick is one CPU cycle; it wraps after 65536
+  cycles (4 ms at 16 MHz), far more than any ISR. That timer needs the I/O
+  clock, so with the profiler on the firmware sleeps in Idle at most.
+  It can be the timer of timebase_2560.h (PROFILER_TIMER = TIMEBASE_TIMER)
+  if that runs without prescaler: PROFILER_Init() then leaves it alone and
+  both share one clock.
+
+  Each profiled ISR starts with one line:
+    ISR (TIMER4_CAPT_vect)
+    {
+        PROFILER_ENTER(PROFILER_TIMER4_CAPT, PROFILER_SINCE(TCNT4, ICR4, 64));
+        ...
+  The second argument is the entry latency in cycles: how long ago the
+  hardware event happened, from the ISR's own timer (counts since the
+  capture / compare match * its prescaler), or PROFILER_NO_WAIT if the
+  peripheral keeps no time stamp (USART). PROFILER_ENTER declares a frame
+  whose cleanup records the run time when the ISR returns, at every return,
+  so bodies with early returns need no second macro. Run time is from
+  PROFILER_ENTER to the return: the prologue / epilogue and the 5 cycle
+  interrupt response are not included, the profiler's own cost is
+  (measured by PROFILER_Init(), printed as 'overhead').
+
+  Debug pin for a logic analyser: #define PROFILER_DEBUG_PORT PORTA,
+  PROFILER_DEBUG_DDR DDRA and PROFILER_DEBUG_BIT PA0. The pin is high while
+  a profiled ISR runs, or only PROFILER_DEBUG_SLOT's if that is defined.
+  - - - - - - - - - - - - - - - - -
+  Slots are per vector. Sonar sensors 1-3 (Timers 5 / 3 / 1) run the same
+  code as sensor 0 and are not profiled.
+  PROFILER_Print(USART0_TX_String) prints one line per slot that has run,
+  cycles as min / mean / max:
+    TIMER4_CAPT 1520 run 38/46/61 wait 9/12/40
+*/
+
+#ifndef PROFILER_2560_H
+#define PROFILER_2560_H
+
+// slots (ISRs of all firmwares)
+#define PROFILER_TIMER0_COMPA   0
+#define PROFILER_TIMER1_COMPA   1
+#define PROFILER_TIMER1_COMPB   2
+#define PROFILER_TIMER2_COMPA   3
+#define PROFILER_TIMER4_CAPT    4
+#define PROFILER_TIMEBASE_OVF   5   // timebase_2560.h
+#define PROFILER_TIMER4_COMPB   6
+#define PROFILER_TIMER4_COMPC   7
+#define PROFILER_USART0_RX      8
+#define PROFILER_USART0_UDRE    9
+#define PROFILER_ADC            10
+#define PROFILER_OVERHEAD       11  // an empty PROFILER_ENTER, measured once
+#define PROFILER_SLOTS          12
+
+#define PROFILER_NO_WAIT        0xFFFF  // entry latency unknown
+// entry latency from a timer: counts since the event * cycles per count, unknown across TOP
+#define PROFILER_SINCE(now, then, cycles_per_count) \
+    ((now) >= (then) ? ((now) - (then)) * (cycles_per_count) : PROFILER_NO_WAIT)
+
+#ifdef PROFILER
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "format.h"
+
+#ifndef PROFILER_TIMER
+#error "PROFILER needs a free 16-bit timer: #define PROFILER_TIMER (1, 3, 4 or 5)"
+#endif
+
+// TCCR ## PROFILER_TIMER ## B etc.
+#define PROFILER_CAT(a, n, b)   a ## n ## b
+#define PROFILER_XCAT(a, n, b)  PROFILER_CAT(a, n, b)
+#define PROFILER_REG(a, b)      PROFILER_XCAT(a, PROFILER_TIMER, b)
+#define PROFILER_TCNT           PROFILER_REG(TCNT, )
+
+#ifdef PROFILER_DEBUG_PORT
+#ifdef PROFILER_DEBUG_SLOT
+#define PROFILER_DEBUG_ON(slot)     ((slot) == PROFILER_DEBUG_SLOT)
+#else
+#define PROFILER_DEBUG_ON(slot)     ((slot) != PROFILER_OVERHEAD)
+#endif
+#define PROFILER_DEBUG_HIGH(slot)   do { if (PROFILER_DEBUG_ON(slot)) PROFILER_DEBUG_PORT |= (1<<PROFILER_DEBUG_BIT); } while (0)
+#define PROFILER_DEBUG_LOW(slot)    do { if (PROFILER_DEBUG_ON(slot)) PROFILER_DEBUG_PORT &= ~(1<<PROFILER_DEBUG_BIT); } while (0)
+#else
+#define PROFILER_DEBUG_HIGH(slot)   do { } while (0)
+#define PROFILER_DEBUG_LOW(slot)    do { } while (0)
+#endif
+
+typedef struct
+{
+    unsigned long calls;
+    unsigned int run_min, run_max;      // cycles from PROFILER_ENTER to the return
+    unsigned long run_total;
+    unsigned long waits;                // calls with a known entry latency
+    unsigned int wait_min, wait_max;    // cycles from the hardware event to PROFILER_ENTER
+    unsigned long wait_total;
+} PROFILER_Slot;
+
+// one per running ISR, on its stack
+typedef struct
+{
+    unsigned int start;
+    unsigned int wait;
+    unsigned char slot;
+} PROFILER_Frame;
+
+PROFILER_Slot profiler_slots[PROFILER_SLOTS];  // written by the ISRs
+
+const char *const profiler_names[PROFILER_SLOTS] =
+{
+    "TIMER0_COMPA", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER2_COMPA",
+    "TIMER4_CAPT", "TIMEBASE_OVF", "TIMER4_COMPB", "TIMER4_COMPC",
+    "USART0_RX", "USART0_UDRE", "ADC", "overhead",
+};
+
+void PROFILER_Init();
+void PROFILER_Reset();
+void PROFILER_Print(void (*print)(char* sText));
+
+// cleanup of the frame: the ISR is returning
+static inline void PROFILER_Exit(PROFILER_Frame *pFrame)
+{
+    unsigned int run = PROFILER_TCNT - pFrame->start;
+    PROFILER_Slot *pSlot = &profiler_slots[pFrame->slot];
+
+    PROFILER_DEBUG_LOW(pFrame->slot);
+    pSlot->calls++;
+    pSlot->run_total += run;
+    if (run < pSlot->run_min) {
+        pSlot->run_min = run;
+    }
+    if (run > pSlot->run_max) {
+        pSlot->run_max = run;
+    }
+    if (pFrame->wait != PROFILER_NO_WAIT)
+    {
+        pSlot->waits++;
+        pSlot->wait_total += pFrame->wait;
+        if (pFrame->wait < pSlot->wait_min) {
+            pSlot->wait_min = pFrame->wait;
+        }
+        if (pFrame->wait > pSlot->wait_max) {
+            pSlot->wait_max = pFrame->wait;
+        }
+    }
+}
+
+// first statement of a profiled ISR (see the top of this file)
+#define PROFILER_ENTER(slot, wait) \
+    PROFILER_Frame profiler_frame __attribute__((cleanup(PROFILER_Exit))) = { PROFILER_TCNT, (wait), (slot) }; \
+    PROFILER_DEBUG_HIGH(slot)
+
+// Start the profiler's timer, clear the table and measure the profiler's own cost
+void PROFILER_Init()
+{
+    unsigned char sreg;
+
+#if defined(TIMEBASE_TIMER) && PROFILER_TIMER == TIMEBASE_TIMER
+#if defined(TIMEBASE_PRESCALER) && TIMEBASE_PRESCALER != 1
+#error "PROFILER_TIMER shares the time base timer, which then needs TIMEBASE_PRESCALER 1"
+#endif
+    // already running freely without prescaler (TIMEBASE_Init())
+#else
+#if PROFILER_TIMER == 1
+    PRR0 &= ~(1<<PRTIM1);
+#else
+    PRR1 &= ~(1<<PROFILER_REG(PRTIM, ));
+#endif
+    PROFILER_REG(TCCR, A) = 0x00;       // normal mode, TOP = 0xFFFF
+    PROFILER_REG(TCCR, B) = (1<<CS10);  // no prescaler: 1 tick = 1 CPU cycle
+    PROFILER_REG(TIMSK, ) = 0x00;
+#endif
+#ifdef PROFILER_DEBUG_PORT
+    PROFILER_DEBUG_DDR |= (1<<PROFILER_DEBUG_BIT);
+#endif
+    PROFILER_Reset();
+
+    sreg = SREG;
+    cli();
+    profiler_slots[PROFILER_OVERHEAD].run_min = 0xFFFF;
+    {
+        PROFILER_ENTER(PROFILER_OVERHEAD, PROFILER_NO_WAIT);
+    }
+    SREG = sreg;
+}
+
+// Clear the counters of every ISR (not the overhead)
+void PROFILER_Reset()
+{
+    unsigned char sreg = SREG;
+
+    cli();
+    for (unsigned char i = 0; i < PROFILER_OVERHEAD; i++)
+    {
+        profiler_slots[i].calls = profiler_slots[i].waits = 0;
+        profiler_slots[i].run_total = profiler_slots[i].wait_total = 0;
+        profiler_slots[i].run_max = profiler_slots[i].wait_max = 0;
+        profiler_slots[i].run_min = profiler_slots[i].wait_min = 0xFFFF;
+    }
+    SREG = sreg;
+}
+
+// "min/mean/max" at p
+static char* PROFILER_Range(char* p, unsigned int min, unsigned long mean, unsigned int max)
+{
+    p = FMT_Uint(p, min);
+    *p++ = '/';
+    p = FMT_Ulong(p, mean);
+    *p++ = '/';
+    return FMT_Uint(p, max);
+}
+
+// One line per slot that has run, through print (e.g. USART0_TX_String)
+void PROFILER_Print(void (*print)(char* sText))
+{
+    PROFILER_Slot slot;
+    char sLine[80];
+    char* p;
+    unsigned char sreg;
+
+    print("ISR calls run / wait cycles min/mean/max:");
+    for (unsigned char i = 0; i < PROFILER_SLOTS; i++)
+    {
+        sreg = SREG; // the ISR may update the slot while it is copied
+        cli();
+        slot = profiler_slots[i];
+        SREG = sreg;
+        if (slot.calls == 0) {
+            continue;
+        }
+        p = FMT_Text(sLine, profiler_names[i]);
+        *p++ = ' ';
+        p = FMT_Text(FMT_Ulong(p, slot.calls), " run ");
+        p = PROFILER_Range(p, slot.run_min, slot.run_total / slot.calls, slot.run_max);
+        if (slot.waits != 0) {
+            PROFILER_Range(FMT_Text(p, " wait "), slot.wait_min, slot.wait_total / slot.waits, slot.wait_max);
+        }
+        print(sLine);
+    }
+}
+
+#else
+
+#define PROFILER_ENTER(slot, wait)
+#define PROFILER_Init()
+#define PROFILER_Reset()
+
+#endif
+
+#endif
@@ -0,0 +1,192 @@
+/*
+  scheduler.h
+
+  Cooperative (non-preemptive) task scheduler.
+  Timer0 generates a 1 ms tick, SCHED_Run() is called from the main loop and
+  runs every task whose period has elapsed or that has been triggered by an
+  event. Tasks must never block: they do a small piece of work and return.
+
+  The run time of each task is measured with the tick counter plus TCNT0,
+  which gives a resolution of one Timer0 count (8 us at 1 MHz). If the
+  firmware includes timebase_2560.h first, SCHED_Micros() is its clock
+  instead (tick resolution, 32-bit, the same time as the other drivers).
+  - - - - - - - - - - - - - - - - -
+  Usage:
+    unsigned char id = SCHED_AddTask(sonar_task, 50);   // every 50 ms
+    unsigned char ev = SCHED_AddTask(serial_task, 0);   // only when triggered
+    SCHED_Trigger(ev);                                  // e.g. from an ISR
+    while(1) { SCHED_Run(); }
+  With all SCHED_MAX_TASKS in use SCHED_AddTask() adds nothing and returns
+  SCHED_NO_TASK, which SCHED_SetPeriod() / SCHED_Trigger() ignore.
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "profiler_2560.h"
+
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS         8
+#endif
+#define SCHED_NO_TASK           0xFF    // SCHED_AddTask(): the table is full
+#define SCHED_TICK_PRESCALER    8
+// Timer0 counts per 1 ms tick (125 at 1 MHz / 8), must fit in 8 bits
+#define SCHED_COUNTS_PER_TICK   (F_CPU / SCHED_TICK_PRESCALER / 1000UL)
+#define SCHED_US_PER_COUNT      (1000000UL * SCHED_TICK_PRESCALER / F_CPU)
+
+typedef struct
+{
+    void (*run)(void);
+    unsigned int period;            // ms between runs, 0 = event triggered only
+    unsigned int last_run;          // tick of the last (scheduled) run
+    volatile unsigned char pending; // set by SCHED_Trigger()
+    unsigned int runtime_us;        // duration of the last run
+    unsigned int runtime_max_us;    // longest run so far
+} SCHED_Task;
+
+SCHED_Task sched_tasks[SCHED_MAX_TASKS];
+unsigned char sched_task_count = 0;
+volatile unsigned int sched_ticks = 0; // ms since SCHED_Init(), wraps every 65.5 s
+
+void SCHED_Init();
+unsigned char SCHED_AddTask(void (*run)(void), unsigned int period);
+void SCHED_SetPeriod(unsigned char id, unsigned int period);
+void SCHED_Trigger(unsigned char id);
+unsigned int SCHED_Millis();
+unsigned long SCHED_Micros();
+void SCHED_Run();
+unsigned char SCHED_Pending();
+
+void SCHED_Init()
+{
+    TCCR0A = (1<<WGM01);            // CTC mode, TOP = OCR0A
+    TCCR0B = (1<<CS01);             // prescaler = 8
+    OCR0A  = SCHED_COUNTS_PER_TICK - 1;
+    TCNT0  = 0x00;
+    TIMSK0 = (1<<OCIE0A);           // 1 ms tick interrupt
+    sched_ticks = 0;
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+    PROFILER_ENTER(PROFILER_TIMER0_COMPA, TCNT0 * SCHED_TICK_PRESCALER); // counts since the compare match
+#ifdef POWER_2560_H
+    POWER_WAKE_SAMPLE(TCNT0 * SCHED_US_PER_COUNT); // counts since the compare match
+#endif
+    sched_ticks++;
+}
+
+// Returns the task id (index) used by SCHED_Trigger / SCHED_SetPeriod, SCHED_NO_TASK if full
+unsigned char SCHED_AddTask(void (*run)(void), unsigned int period)
+{
+    SCHED_Task *task;
+
+    if (sched_task_count >= SCHED_MAX_TASKS) {
+        return SCHED_NO_TASK;
+    }
+    task = &sched_tasks[sched_task_count];
+    task->run = run;
+    task->period = period;
+    task->last_run = SCHED_Millis();
+    task->pending = 0;
+    task->runtime_us = task->runtime_max_us = 0;
+    return sched_task_count++;
+}
+
+void SCHED_SetPeriod(unsigned char id, unsigned int period)
+{
+    if (id < sched_task_count) {
+        sched_tasks[id].period = period;
+    }
+}
+
+void SCHED_Trigger(unsigned char id)
+{
+    if (id < sched_task_count) {
+        sched_tasks[id].pending = 1;
+    }
+}
+
+unsigned int SCHED_Millis()
+{
+    unsigned int ticks;
+    unsigned char sreg = SREG; // 16-bit read must not be split by the tick ISR
+    cli();
+    ticks = sched_ticks;
+    SREG = sreg;
+    return ticks;
+}
+
+// Microseconds since SCHED_Init() (wraps every 65.5 s like the tick counter),
+// or since TIMEBASE_Init() (wraps modulo 2^32)
+unsigned long SCHED_Micros()
+{
+#ifdef TIMEBASE_2560_H
+    return TIMEBASE_Micros();
+#else
+    unsigned int ticks;
+    unsigned char count;
+    unsigned char sreg = SREG;
+    cli();
+    ticks = sched_ticks;
+    count = TCNT0;
+    if ((TIFR0 & (1<<OCF0A)) && count < SCHED_COUNTS_PER_TICK / 2) {
+        ticks++; // the counter wrapped but the tick ISR has not run yet
+    }
+    SREG = sreg;
+    return (unsigned long)ticks * 1000UL + (unsigned long)count * SCHED_US_PER_COUNT;
+#endif
+}
+
+// Run every task that is due, in the order they were added
+void SCHED_Run()
+{
+    unsigned long start, elapsed;
+    unsigned int now;
+    SCHED_Task *task;
+
+    for (unsigned char i = 0; i < sched_task_count; i++)
+    {
+        task = &sched_tasks[i];
+        now = SCHED_Millis();
+        if (task->pending) {
+            task->pending = 0;
+        }
+        else if (task->period == 0 || (unsigned int)(now - task->last_run) < task->period) {
+            continue;
+        }
+        else {
+            task->last_run = now;
+        }
+        start = SCHED_Micros();
+        task->run();
+        elapsed = SCHED_Micros();
+#ifndef TIMEBASE_2560_H
+        if (elapsed < start) {
+            elapsed += 65536000UL; // SCHED_Micros() wrapped with the tick counter
+        }
+#endif
+        elapsed -= start;
+        task->runtime_us = (elapsed > 0xFFFF) ? 0xFFFF : (unsigned int)elapsed;
+        if (task->runtime_us > task->runtime_max_us) {
+            task->runtime_max_us = task->runtime_us;
+        }
+    }
+}
+
+// True if a task has been triggered and not run yet (checked before sleeping)
+unsigned char SCHED_Pending()
+{
+    for (unsigned char i = 0; i < sched_task_count; i++)
+    {
+        if (sched_tasks[i].pending) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+  timebase_2560.h
+
+  32-bit monotonic time base: a free-running 16-bit timer (normal mode,
+  TOP = 0xFFFF) plus an overflow count as the high word. The firmware
+  picks the timer and its prescaler before the #include:
+    #define TIMEBASE_TIMER      4
+    #define TIMEBASE_PRESCALER  64      // 1, 8, 64, 256 or 1024
+  and calls TIMEBASE_Init() once (it also switches the timer's clock on in
+  PRR0 / PRR1). The timer's ISR(TIMERn_OVF_vect) is defined here.
+  - - - - - - - - - - - - - - - - -
+  Ticks per us / wrap of the 32-bit count:
+    1 MHz  / 1  = 1 us      71 min       16 MHz / 64 = 4 us      4.8 h
+    1 MHz  / 8  = 8 us      9.5 h        16 MHz / 8  = 0.5 us    36 min
+  - - - - - - - - - - - - - - - - -
+  TIMEBASE_Now(): the overflow ISR may not have run yet when the counter
+  has just wrapped (interrupts off, or a higher priority ISR running), so
+  with TOVn pending a low count is taken as after the wrap (high word + 1).
+  TIMEBASE_Extend(counts): a 16-bit value of the same timer (ICRn at a
+  capture, OCRn at a compare match) to 32 bits, as now minus its age
+  modulo 2^16. Correct for any value less than one wrap old, whichever of
+  the capture and overflow ISRs runs first. Captures on another timer with
+  the same tick: TIMEBASE_Now() - (TCNTm - ICRm) (see sonar.h).
+  Time differences are plain unsigned subtractions of the 32-bit values.
+*/
+
+#ifndef TIMEBASE_2560_H
+#define TIMEBASE_2560_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "profiler_2560.h"
+
+#ifndef TIMEBASE_TIMER
+#error "timebase_2560.h: #define TIMEBASE_TIMER (1, 3, 4 or 5) before the #include"
+#endif
+#ifndef TIMEBASE_PRESCALER
+#define TIMEBASE_PRESCALER      1
+#endif
+
+#if TIMEBASE_PRESCALER == 1
+#define TIMEBASE_CS             (1<<CS10)
+#elif TIMEBASE_PRESCALER == 8
+#define TIMEBASE_CS             (1<<CS11)
+#elif TIMEBASE_PRESCALER == 64
+#define TIMEBASE_CS             (1<<CS11 | 1<<CS10)
+#elif TIMEBASE_PRESCALER == 256
+#define TIMEBASE_CS             (1<<CS12)
+#elif TIMEBASE_PRESCALER == 1024
+#define TIMEBASE_CS             (1<<CS12 | 1<<CS10)
+#else
+#error "TIMEBASE_PRESCALER must be 1, 8, 64, 256 or 1024"
+#endif
+
+#define TIMEBASE_TICKS_PER_S    (F_CPU / TIMEBASE_PRESCALER)
+#define TIMEBASE_MS(ms)         ((unsigned long)(ms) * (TIMEBASE_TICKS_PER_S / 1000UL))
+#define TIMEBASE_US(us)         ((unsigned long)(us) * (TIMEBASE_TICKS_PER_S / 1000UL) / 1000UL)
+
+// TCNT ## TIMEBASE_TIMER etc.
+#define TIMEBASE_CAT(a, n, b)   a ## n ## b
+#define TIMEBASE_XCAT(a, n, b)  TIMEBASE_CAT(a, n, b)
+#define TIMEBASE_REG(a, b)      TIMEBASE_XCAT(a, TIMEBASE_TIMER, b)
+#define TIMEBASE_TCNT           TIMEBASE_REG(TCNT, )
+
+volatile unsigned int timebase_high = 0;    // overflows: bits 31-16 of the time
+
+void TIMEBASE_Init();
+unsigned long TIMEBASE_Now();
+unsigned long TIMEBASE_Extend(unsigned int counts);
+unsigned long TIMEBASE_Micros();
+
+// Free-running timer, overflow interrupt on. Other interrupts of the same
+// timer (capture, compare) can be enabled afterwards with |=.
+void TIMEBASE_Init()
+{
+    unsigned char sreg = SREG;
+
+    cli();
+#if TIMEBASE_TIMER == 1
+    PRR0 &= ~(1<<PRTIM1);
+#else
+    PRR1 &= ~(1<<TIMEBASE_REG(PRTIM, ));
+#endif
+    TIMEBASE_REG(TCCR, A) = 0x00;           // normal mode
+    TIMEBASE_REG(TCCR, B) = TIMEBASE_CS;
+    TIMEBASE_TCNT = 0;
+    timebase_high = 0;
+    TIMEBASE_REG(TIFR, ) = (1<<TOV1);       // same bit in every 16-bit timer
+    TIMEBASE_REG(TIMSK, ) |= (1<<TOIE1);
+    SREG = sreg;
+}
+
+ISR(TIMEBASE_XCAT(TIMER, TIMEBASE_TIMER, _OVF_vect))
+{
+    PROFILER_ENTER(PROFILER_TIMEBASE_OVF, TIMEBASE_TCNT * TIMEBASE_PRESCALER); // counts since the wrap
+    timebase_high++;
+}
+
+// Ticks since TIMEBASE_Init()
+unsigned long TIMEBASE_Now()
+{
+    unsigned int high, low;
+    unsigned char sreg = SREG;
+
+    cli();
+    high = timebase_high;
+    low = TIMEBASE_TCNT;
+    if ((TIMEBASE_REG(TIFR, ) & (1<<TOV1)) && low < 0x8000) {
+        high++; // wrapped, the overflow ISR has not run yet
+    }
+    SREG = sreg;
+    return ((unsigned long)high << 16) | low;
+}
+
+// A 16-bit value of this timer (less than one wrap old) as ticks since TIMEBASE_Init()
+unsigned long TIMEBASE_Extend(unsigned int counts)
+{
+    unsigned long now = TIMEBASE_Now();
+    return now - (unsigned int)((unsigned int)now - counts);
+}
+
+// Microseconds since TIMEBASE_Init(), wraps modulo 2^32 like the ticks
+unsigned long TIMEBASE_Micros()
+{
+#if TIMEBASE_PRESCALER % (F_CPU / 1000000UL) != 0
+#error "TIMEBASE_Micros() needs a whole number of us per tick"
+#endif
+    return TIMEBASE_Now() * (TIMEBASE_PRESCALER / (F_CPU / 1000000UL));
+}
+
+#endif
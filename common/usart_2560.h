@@ -0,0 +1,252 @@
+/*
+  usart_2560.h
+  
+  Updated: Victor Hansen, 06.11.2020
+  
+  Based on:
+  USART_2560_C (Richard Anthony, 21th October 2015)
+  - - - - - - - - - - - - - - - - -
+  
+  Communication setup of USART:
+  * Bits per second = 9600
+  * Data bits       = 8
+  * Parity          = None
+  * Stop bits       = 1
+  * Flow control    = H/W
+
+  Transmit is interrupt driven: USART0_TX_SingleByte() only copies the byte
+  into an SRAM ring buffer and returns, USART0_UDRE_vect drains the buffer
+  into UDR0 one byte per 'data register empty' interrupt.
+
+  Receive is buffered the same way: USART0_RX_vect only stores the byte (and
+  counts errors), the main loop assembles lines with USART0_RX_GetLine() and
+  does the command work outside the interrupt.
+
+  Shared by all firmwares: define F_CPU first, and override the buffer sizes,
+  full policy or USART0_TX_CRLF (end strings with CR LF instead of CR) before
+  the #include. The firmware prints its own prompt after USART0_SETUP_9600_BAUD().
+  
+  */
+
+#ifndef USART_2560_H
+#define USART_2560_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "profiler_2560.h"
+
+#define CR  0x0D
+#define LF  0x0A
+
+// UBRR0 for 9600 baud with U2X0 = 1: 12 at 1 MHz, 207 at 16 MHz
+#define USART0_UBRR_9600        (F_CPU / 8UL / 9600UL - 1)
+
+// TX ring buffer size in bytes, must be a power of two (<= 256)
+#ifndef USART0_TX_BUFFER_SIZE
+#define USART0_TX_BUFFER_SIZE   128
+#endif
+#define USART0_TX_BUFFER_MASK   (USART0_TX_BUFFER_SIZE - 1)
+
+// What to do when a byte is queued and the TX buffer is full
+#define USART0_TX_DROP          0   // discard the new byte
+#define USART0_TX_BLOCK         1   // wait for the UDRE interrupt to make room
+#define USART0_TX_OVERWRITE     2   // discard the oldest queued byte
+
+#ifndef USART0_TX_FULL_POLICY
+#define USART0_TX_FULL_POLICY   USART0_TX_DROP
+#endif
+
+// RX ring buffer size in bytes, must be a power of two (<= 256)
+#ifndef USART0_RX_BUFFER_SIZE
+#define USART0_RX_BUFFER_SIZE   32
+#endif
+#define USART0_RX_BUFFER_MASK   (USART0_RX_BUFFER_SIZE - 1)
+
+void USART0_SETUP_9600_BAUD();
+void USART0_TX_SingleByte(unsigned char cByte);
+void USART0_TX_String(char* sData);
+void USART0_TX_Flush();
+int USART0_RX_Byte();
+unsigned char USART0_RX_GetLine(char* sLine, unsigned char iSize);
+
+volatile unsigned char usart0_tx_buffer[USART0_TX_BUFFER_SIZE];
+volatile unsigned char usart0_tx_head = 0; // next free slot, written by the caller
+volatile unsigned char usart0_tx_tail = 0; // next byte to send, written by the ISR
+volatile unsigned char usart0_tx_policy = USART0_TX_FULL_POLICY;
+volatile unsigned int  usart0_tx_dropped = 0; // bytes lost because the buffer was full
+volatile unsigned char usart0_tx_active = 0;  // bytes queued since the last TXC0 (the shift register may still be busy)
+
+volatile unsigned char usart0_rx_buffer[USART0_RX_BUFFER_SIZE];
+volatile unsigned char usart0_rx_head = 0; // written by the ISR
+volatile unsigned char usart0_rx_tail = 0; // written by the main loop
+volatile unsigned int  usart0_rx_overruns = 0;     // DOR0: byte lost in the USART itself
+volatile unsigned int  usart0_rx_frame_errors = 0; // FE0: bad stop bit, byte discarded
+volatile unsigned int  usart0_rx_dropped = 0;      // RX ring buffer full, byte discarded
+
+void USART0_SETUP_9600_BAUD()
+{
+    // USART Control and Status Register A
+    UCSR0A = (1<<U2X0); // Double the USART Transmission Speed
+    
+    // USART Control and Status Register B
+    /* RX Complete Interrupt Enable, RX Enable, TX Enable, 8-bit data */
+    UCSR0B = (1<<RXCIE0 | 1<<RXEN0 | 1<<TXEN0);
+    
+ 
+    // USART Control and Status Register C
+    /* Asynchronous, No Parity, 1 stop, 8-bit data, Falling XCK edge */
+    UCSR0C = (1<<UCSZ01 | 1<<UCSZ00 | 1<<UCPOL0);
+  
+    // UBRR0 - USART Baud Rate Register (16-bit register, comprising UBRR0H and UBRR0L)
+    UBRR0H = USART0_UBRR_9600 >> 8; // U2X must be set to '1' in UCSRA
+    UBRR0L = USART0_UBRR_9600 & 0xFF;
+
+    usart0_tx_head = usart0_tx_tail = 0;
+    usart0_rx_head = usart0_rx_tail = 0;
+}
+
+void USART0_TX_SingleByte(unsigned char cByte)
+{
+    // Queue the byte and return, the UDRE interrupt sends it.
+    // The head is updated with interrupts off so ISRs may also print.
+    unsigned char sreg, next;
+    while (1)
+    {
+        sreg = SREG;
+        cli();
+        next = (usart0_tx_head + 1) & USART0_TX_BUFFER_MASK;
+        if (next != usart0_tx_tail) {
+            break; // room in the buffer
+        }
+        if (usart0_tx_policy == USART0_TX_OVERWRITE)
+        {
+            usart0_tx_tail = (usart0_tx_tail + 1) & USART0_TX_BUFFER_MASK; // drop oldest
+            usart0_tx_dropped++;
+            break;
+        }
+        // blocking is only possible while the UDRE interrupt can run
+        if (usart0_tx_policy == USART0_TX_DROP || !(sreg & (1<<SREG_I)))
+        {
+            usart0_tx_dropped++;
+            SREG = sreg;
+            return;
+        }
+        SREG = sreg; // USART0_TX_BLOCK: let the ISR drain a byte, then retry
+    }
+    usart0_tx_buffer[usart0_tx_head] = cByte;
+    usart0_tx_head = next;
+    usart0_tx_active = 1;
+    // writing one clears TXC0, it is set again once the last byte is out (FE0 / DOR0 / UPE0 must be written 0)
+    UCSR0A = (UCSR0A & (1<<U2X0 | 1<<MPCM0)) | (1<<TXC0);
+    UCSR0B |= (1<<UDRIE0); // Data Register Empty Interrupt Enable
+    SREG = sreg;
+}
+
+// Wait until every queued byte has been handed to the USART (needs interrupts on)
+void USART0_TX_Flush()
+{
+    while (usart0_tx_head != usart0_tx_tail);
+}
+
+ISR(USART0_UDRE_vect) // USART Data Register Empty Interrupt Handler
+{
+    PROFILER_ENTER(PROFILER_USART0_UDRE, PROFILER_NO_WAIT);
+    if (usart0_tx_head != usart0_tx_tail)
+    {
+        UDR0 = usart0_tx_buffer[usart0_tx_tail];
+        usart0_tx_tail = (usart0_tx_tail + 1) & USART0_TX_BUFFER_MASK;
+    }
+    if (usart0_tx_head == usart0_tx_tail)
+    {
+        UCSR0B &= ~(1<<UDRIE0); // nothing left to send
+    }
+}
+
+void USART0_TX_String(char* sData)
+{
+    int iCount;
+    int iStrlen = strlen(sData);
+    if(0 != iStrlen)
+    {
+        for(iCount = 0; iCount < iStrlen; iCount++)
+        {
+            USART0_TX_SingleByte(sData[iCount]);
+        }
+        USART0_TX_SingleByte(CR);
+#ifdef USART0_TX_CRLF
+        USART0_TX_SingleByte(LF);
+#endif
+    }
+}
+
+ISR(USART0_RX_vect) // USART Receive-Complete Interrupt Handler
+{
+    PROFILER_ENTER(PROFILER_USART0_RX, PROFILER_NO_WAIT);
+    // Error flags must be read before UDR0, reading UDR0 clears them
+    unsigned char cStatus = UCSR0A;
+    unsigned char cData = UDR0;
+    unsigned char next = (usart0_rx_head + 1) & USART0_RX_BUFFER_MASK;
+
+    if (cStatus & (1<<FE0))
+    {
+        usart0_rx_frame_errors++;
+        return;
+    }
+    if (cStatus & (1<<DOR0)) {
+        usart0_rx_overruns++; // the byte in cData is fine, the one before it was lost
+    }
+    if (next == usart0_rx_tail)
+    {
+        usart0_rx_dropped++;
+        return;
+    }
+    usart0_rx_buffer[usart0_rx_head] = cData;
+    usart0_rx_head = next;
+}
+
+// Returns the next received byte, or -1 if the buffer is empty
+int USART0_RX_Byte()
+{
+    unsigned char cData;
+    if (usart0_rx_head == usart0_rx_tail) {
+        return -1;
+    }
+    cData = usart0_rx_buffer[usart0_rx_tail];
+    usart0_rx_tail = (usart0_rx_tail + 1) & USART0_RX_BUFFER_MASK;
+    return cData;
+}
+
+/*
+  Collect received bytes into sLine until CR or LF. Never blocks: returns the
+  line length once a complete, non-empty line is in sLine (null terminated),
+  otherwise 0. Characters beyond iSize-1 are discarded.
+  A partial line is kept in sLine, so pass the same buffer on every call.
+*/
+unsigned char USART0_RX_GetLine(char* sLine, unsigned char iSize)
+{
+    static unsigned char iLength = 0;
+    unsigned char iDone;
+    int iData;
+
+    while ((iData = USART0_RX_Byte()) >= 0)
+    {
+        if (iData == CR || iData == '\n')
+        {
+            if (0 == iLength) {
+                continue; // ignore empty lines (e.g. the LF of a CR LF pair)
+            }
+            sLine[iLength] = '\0';
+            iDone = iLength;
+            iLength = 0;
+            return iDone;
+        }
+        if (iLength < iSize - 1) {
+            sLine[iLength++] = (char)iData;
+        }
+    }
+    return 0;
+}
+
+#endif
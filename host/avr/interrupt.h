@@ -0,0 +1,16 @@
+/*
+  avr/interrupt.h for the host build: an ISR is a plain function the
+  benchmark calls. sei() / cli() are instructions, not SREG accesses, so
+  they change the I bit without being counted.
+*/
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include "io.h"
+
+#define ISR(vector)     void vector(void); void vector(void)
+#define sei()           HOST_Set(SREG, SREG | (1<<SREG_I))
+#define cli()           HOST_Set(SREG, SREG & ~(1<<SREG_I))
+
+#endif
@@ -0,0 +1,804 @@
+/*
+  avr/io.h for the host build (see host/host_io.h)
+
+  Every register is a byte of host_io[], at its ATmega2560 data space
+  address, and every use of a register name goes through host_reg8() /
+  host_reg16(), which count the access. 16-bit registers count as two
+  byte accesses, as on the AVR. Only the registers and bits the firmwares
+  in this repository use are listed.
+*/
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include "../host_io.h"
+
+#define _BV(b)              (1u<<(b))
+#define bit_is_set(r, b)    ((r) & _BV(b))
+
+// 8-bit registers
+#define PINA     HOST_REG8(0x20)
+#define DDRA     HOST_REG8(0x21)
+#define PORTA    HOST_REG8(0x22)
+#define PINB     HOST_REG8(0x23)
+#define DDRB     HOST_REG8(0x24)
+#define PORTB    HOST_REG8(0x25)
+#define PINC     HOST_REG8(0x26)
+#define DDRC     HOST_REG8(0x27)
+#define PORTC    HOST_REG8(0x28)
+#define PIND     HOST_REG8(0x29)
+#define DDRD     HOST_REG8(0x2A)
+#define PORTD    HOST_REG8(0x2B)
+#define PINE     HOST_REG8(0x2C)
+#define DDRE     HOST_REG8(0x2D)
+#define PORTE    HOST_REG8(0x2E)
+#define PINF     HOST_REG8(0x2F)
+#define DDRF     HOST_REG8(0x30)
+#define PORTF    HOST_REG8(0x31)
+#define PING     HOST_REG8(0x32)
+#define DDRG     HOST_REG8(0x33)
+#define PORTG    HOST_REG8(0x34)
+#define TIFR0    HOST_REG8(0x35)
+#define TIFR1    HOST_REG8(0x36)
+#define TIFR2    HOST_REG8(0x37)
+#define TIFR3    HOST_REG8(0x38)
+#define TIFR4    HOST_REG8(0x39)
+#define TIFR5    HOST_REG8(0x3A)
+#define PCIFR    HOST_REG8(0x3B)
+#define EIFR     HOST_REG8(0x3C)
+#define EIMSK    HOST_REG8(0x3D)
+#define GTCCR    HOST_REG8(0x43)
+#define TCCR0A   HOST_REG8(0x44)
+#define TCCR0B   HOST_REG8(0x45)
+#define TCNT0    HOST_REG8(0x46)
+#define OCR0A    HOST_REG8(0x47)
+#define OCR0B    HOST_REG8(0x48)
+#define SPCR     HOST_REG8(0x4C)
+#define ACSR     HOST_REG8(0x50)
+#define SMCR     HOST_REG8(0x53)
+#define MCUCR    HOST_REG8(0x55)
+#define SREG     HOST_REG8(0x5F)
+#define PRR0     HOST_REG8(0x64)
+#define PRR1     HOST_REG8(0x65)
+#define PCICR    HOST_REG8(0x68)
+#define EICRA    HOST_REG8(0x69)
+#define EICRB    HOST_REG8(0x6A)
+#define PCMSK0   HOST_REG8(0x6B)
+#define PCMSK1   HOST_REG8(0x6C)
+#define PCMSK2   HOST_REG8(0x6D)
+#define TIMSK0   HOST_REG8(0x6E)
+#define TIMSK1   HOST_REG8(0x6F)
+#define TIMSK2   HOST_REG8(0x70)
+#define TIMSK3   HOST_REG8(0x71)
+#define TIMSK4   HOST_REG8(0x72)
+#define TIMSK5   HOST_REG8(0x73)
+#define ADCL     HOST_REG8(0x78)
+#define ADCH     HOST_REG8(0x79)
+#define ADCSRA   HOST_REG8(0x7A)
+#define ADCSRB   HOST_REG8(0x7B)
+#define ADMUX    HOST_REG8(0x7C)
+#define DIDR2    HOST_REG8(0x7D)
+#define DIDR0    HOST_REG8(0x7E)
+#define DIDR1    HOST_REG8(0x7F)
+#define TCCR1A   HOST_REG8(0x80)
+#define TCCR1B   HOST_REG8(0x81)
+#define TCCR1C   HOST_REG8(0x82)
+#define TCNT1L   HOST_REG8(0x84)
+#define TCNT1H   HOST_REG8(0x85)
+#define ICR1L    HOST_REG8(0x86)
+#define ICR1H    HOST_REG8(0x87)
+#define OCR1AL   HOST_REG8(0x88)
+#define OCR1AH   HOST_REG8(0x89)
+#define OCR1BL   HOST_REG8(0x8A)
+#define OCR1BH   HOST_REG8(0x8B)
+#define OCR1CL   HOST_REG8(0x8C)
+#define OCR1CH   HOST_REG8(0x8D)
+#define TCCR3A   HOST_REG8(0x90)
+#define TCCR3B   HOST_REG8(0x91)
+#define TCCR3C   HOST_REG8(0x92)
+#define TCNT3L   HOST_REG8(0x94)
+#define TCNT3H   HOST_REG8(0x95)
+#define ICR3L    HOST_REG8(0x96)
+#define ICR3H    HOST_REG8(0x97)
+#define OCR3AL   HOST_REG8(0x98)
+#define OCR3AH   HOST_REG8(0x99)
+#define OCR3BL   HOST_REG8(0x9A)
+#define OCR3BH   HOST_REG8(0x9B)
+#define OCR3CL   HOST_REG8(0x9C)
+#define OCR3CH   HOST_REG8(0x9D)
+#define TCCR4A   HOST_REG8(0xA0)
+#define TCCR4B   HOST_REG8(0xA1)
+#define TCCR4C   HOST_REG8(0xA2)
+#define TCNT4L   HOST_REG8(0xA4)
+#define TCNT4H   HOST_REG8(0xA5)
+#define ICR4L    HOST_REG8(0xA6)
+#define ICR4H    HOST_REG8(0xA7)
+#define OCR4AL   HOST_REG8(0xA8)
+#define OCR4AH   HOST_REG8(0xA9)
+#define OCR4BL   HOST_REG8(0xAA)
+#define OCR4BH   HOST_REG8(0xAB)
+#define OCR4CL   HOST_REG8(0xAC)
+#define OCR4CH   HOST_REG8(0xAD)
+#define TCCR2A   HOST_REG8(0xB0)
+#define TCCR2B   HOST_REG8(0xB1)
+#define TCNT2    HOST_REG8(0xB2)
+#define OCR2A    HOST_REG8(0xB3)
+#define OCR2B    HOST_REG8(0xB4)
+#define ASSR     HOST_REG8(0xB6)
+#define TWCR     HOST_REG8(0xBC)
+#define UCSR0A   HOST_REG8(0xC0)
+#define UCSR0B   HOST_REG8(0xC1)
+#define UCSR0C   HOST_REG8(0xC2)
+#define UBRR0L   HOST_REG8(0xC4)
+#define UBRR0H   HOST_REG8(0xC5)
+#define UDR0     HOST_REG8(0xC6)
+#define UCSR1B   HOST_REG8(0xC9)
+#define UCSR2B   HOST_REG8(0xD1)
+#define PINH     HOST_REG8(0x100)
+#define DDRH     HOST_REG8(0x101)
+#define PORTH    HOST_REG8(0x102)
+#define PINJ     HOST_REG8(0x103)
+#define DDRJ     HOST_REG8(0x104)
+#define PORTJ    HOST_REG8(0x105)
+#define PINK     HOST_REG8(0x106)
+#define DDRK     HOST_REG8(0x107)
+#define PORTK    HOST_REG8(0x108)
+#define PINL     HOST_REG8(0x109)
+#define DDRL     HOST_REG8(0x10A)
+#define PORTL    HOST_REG8(0x10B)
+#define TCCR5A   HOST_REG8(0x120)
+#define TCCR5B   HOST_REG8(0x121)
+#define TCCR5C   HOST_REG8(0x122)
+#define TCNT5L   HOST_REG8(0x124)
+#define TCNT5H   HOST_REG8(0x125)
+#define ICR5L    HOST_REG8(0x126)
+#define ICR5H    HOST_REG8(0x127)
+#define OCR5AL   HOST_REG8(0x128)
+#define OCR5AH   HOST_REG8(0x129)
+#define OCR5BL   HOST_REG8(0x12A)
+#define OCR5BH   HOST_REG8(0x12B)
+#define OCR5CL   HOST_REG8(0x12C)
+#define OCR5CH   HOST_REG8(0x12D)
+#define UCSR3B   HOST_REG8(0x131)
+
+// 16-bit registers (low byte address)
+#define ADC      HOST_REG16(0x78)
+#define ADCW     HOST_REG16(0x78)
+#define TCNT1    HOST_REG16(0x84)
+#define ICR1     HOST_REG16(0x86)
+#define OCR1A    HOST_REG16(0x88)
+#define OCR1B    HOST_REG16(0x8A)
+#define OCR1C    HOST_REG16(0x8C)
+#define TCNT3    HOST_REG16(0x94)
+#define ICR3     HOST_REG16(0x96)
+#define OCR3A    HOST_REG16(0x98)
+#define OCR3B    HOST_REG16(0x9A)
+#define OCR3C    HOST_REG16(0x9C)
+#define TCNT4    HOST_REG16(0xA4)
+#define ICR4     HOST_REG16(0xA6)
+#define OCR4A    HOST_REG16(0xA8)
+#define OCR4B    HOST_REG16(0xAA)
+#define OCR4C    HOST_REG16(0xAC)
+#define TCNT5    HOST_REG16(0x124)
+#define ICR5     HOST_REG16(0x126)
+#define OCR5A    HOST_REG16(0x128)
+#define OCR5B    HOST_REG16(0x12A)
+#define OCR5C    HOST_REG16(0x12C)
+
+// bits
+#define SREG_I     7
+#define PA0        0
+#define PINA0      0
+#define DDA0       0
+#define PORTA0     0
+#define PB0        0
+#define PINB0      0
+#define DDB0       0
+#define PORTB0     0
+#define PC0        0
+#define PINC0      0
+#define DDC0       0
+#define PORTC0     0
+#define PD0        0
+#define PIND0      0
+#define DDD0       0
+#define PORTD0     0
+#define PE0        0
+#define PINE0      0
+#define DDE0       0
+#define PORTE0     0
+#define PF0        0
+#define PINF0      0
+#define DDF0       0
+#define PORTF0     0
+#define PG0        0
+#define PING0      0
+#define DDG0       0
+#define PORTG0     0
+#define PH0        0
+#define PINH0      0
+#define DDH0       0
+#define PORTH0     0
+#define PJ0        0
+#define PINJ0      0
+#define DDJ0       0
+#define PORTJ0     0
+#define PK0        0
+#define PINK0      0
+#define DDK0       0
+#define PORTK0     0
+#define PL0        0
+#define PINL0      0
+#define DDL0       0
+#define PORTL0     0
+#define PA1        1
+#define PINA1      1
+#define DDA1       1
+#define PORTA1     1
+#define PB1        1
+#define PINB1      1
+#define DDB1       1
+#define PORTB1     1
+#define PC1        1
+#define PINC1      1
+#define DDC1       1
+#define PORTC1     1
+#define PD1        1
+#define PIND1      1
+#define DDD1       1
+#define PORTD1     1
+#define PE1        1
+#define PINE1      1
+#define DDE1       1
+#define PORTE1     1
+#define PF1        1
+#define PINF1      1
+#define DDF1       1
+#define PORTF1     1
+#define PG1        1
+#define PING1      1
+#define DDG1       1
+#define PORTG1     1
+#define PH1        1
+#define PINH1      1
+#define DDH1       1
+#define PORTH1     1
+#define PJ1        1
+#define PINJ1      1
+#define DDJ1       1
+#define PORTJ1     1
+#define PK1        1
+#define PINK1      1
+#define DDK1       1
+#define PORTK1     1
+#define PL1        1
+#define PINL1      1
+#define DDL1       1
+#define PORTL1     1
+#define PA2        2
+#define PINA2      2
+#define DDA2       2
+#define PORTA2     2
+#define PB2        2
+#define PINB2      2
+#define DDB2       2
+#define PORTB2     2
+#define PC2        2
+#define PINC2      2
+#define DDC2       2
+#define PORTC2     2
+#define PD2        2
+#define PIND2      2
+#define DDD2       2
+#define PORTD2     2
+#define PE2        2
+#define PINE2      2
+#define DDE2       2
+#define PORTE2     2
+#define PF2        2
+#define PINF2      2
+#define DDF2       2
+#define PORTF2     2
+#define PG2        2
+#define PING2      2
+#define DDG2       2
+#define PORTG2     2
+#define PH2        2
+#define PINH2      2
+#define DDH2       2
+#define PORTH2     2
+#define PJ2        2
+#define PINJ2      2
+#define DDJ2       2
+#define PORTJ2     2
+#define PK2        2
+#define PINK2      2
+#define DDK2       2
+#define PORTK2     2
+#define PL2        2
+#define PINL2      2
+#define DDL2       2
+#define PORTL2     2
+#define PA3        3
+#define PINA3      3
+#define DDA3       3
+#define PORTA3     3
+#define PB3        3
+#define PINB3      3
+#define DDB3       3
+#define PORTB3     3
+#define PC3        3
+#define PINC3      3
+#define DDC3       3
+#define PORTC3     3
+#define PD3        3
+#define PIND3      3
+#define DDD3       3
+#define PORTD3     3
+#define PE3        3
+#define PINE3      3
+#define DDE3       3
+#define PORTE3     3
+#define PF3        3
+#define PINF3      3
+#define DDF3       3
+#define PORTF3     3
+#define PG3        3
+#define PING3      3
+#define DDG3       3
+#define PORTG3     3
+#define PH3        3
+#define PINH3      3
+#define DDH3       3
+#define PORTH3     3
+#define PJ3        3
+#define PINJ3      3
+#define DDJ3       3
+#define PORTJ3     3
+#define PK3        3
+#define PINK3      3
+#define DDK3       3
+#define PORTK3     3
+#define PL3        3
+#define PINL3      3
+#define DDL3       3
+#define PORTL3     3
+#define PA4        4
+#define PINA4      4
+#define DDA4       4
+#define PORTA4     4
+#define PB4        4
+#define PINB4      4
+#define DDB4       4
+#define PORTB4     4
+#define PC4        4
+#define PINC4      4
+#define DDC4       4
+#define PORTC4     4
+#define PD4        4
+#define PIND4      4
+#define DDD4       4
+#define PORTD4     4
+#define PE4        4
+#define PINE4      4
+#define DDE4       4
+#define PORTE4     4
+#define PF4        4
+#define PINF4      4
+#define DDF4       4
+#define PORTF4     4
+#define PG4        4
+#define PING4      4
+#define DDG4       4
+#define PORTG4     4
+#define PH4        4
+#define PINH4      4
+#define DDH4       4
+#define PORTH4     4
+#define PJ4        4
+#define PINJ4      4
+#define DDJ4       4
+#define PORTJ4     4
+#define PK4        4
+#define PINK4      4
+#define DDK4       4
+#define PORTK4     4
+#define PL4        4
+#define PINL4      4
+#define DDL4       4
+#define PORTL4     4
+#define PA5        5
+#define PINA5      5
+#define DDA5       5
+#define PORTA5     5
+#define PB5        5
+#define PINB5      5
+#define DDB5       5
+#define PORTB5     5
+#define PC5        5
+#define PINC5      5
+#define DDC5       5
+#define PORTC5     5
+#define PD5        5
+#define PIND5      5
+#define DDD5       5
+#define PORTD5     5
+#define PE5        5
+#define PINE5      5
+#define DDE5       5
+#define PORTE5     5
+#define PF5        5
+#define PINF5      5
+#define DDF5       5
+#define PORTF5     5
+#define PG5        5
+#define PING5      5
+#define DDG5       5
+#define PORTG5     5
+#define PH5        5
+#define PINH5      5
+#define DDH5       5
+#define PORTH5     5
+#define PJ5        5
+#define PINJ5      5
+#define DDJ5       5
+#define PORTJ5     5
+#define PK5        5
+#define PINK5      5
+#define DDK5       5
+#define PORTK5     5
+#define PL5        5
+#define PINL5      5
+#define DDL5       5
+#define PORTL5     5
+#define PA6        6
+#define PINA6      6
+#define DDA6       6
+#define PORTA6     6
+#define PB6        6
+#define PINB6      6
+#define DDB6       6
+#define PORTB6     6
+#define PC6        6
+#define PINC6      6
+#define DDC6       6
+#define PORTC6     6
+#define PD6        6
+#define PIND6      6
+#define DDD6       6
+#define PORTD6     6
+#define PE6        6
+#define PINE6      6
+#define DDE6       6
+#define PORTE6     6
+#define PF6        6
+#define PINF6      6
+#define DDF6       6
+#define PORTF6     6
+#define PG6        6
+#define PING6      6
+#define DDG6       6
+#define PORTG6     6
+#define PH6        6
+#define PINH6      6
+#define DDH6       6
+#define PORTH6     6
+#define PJ6        6
+#define PINJ6      6
+#define DDJ6       6
+#define PORTJ6     6
+#define PK6        6
+#define PINK6      6
+#define DDK6       6
+#define PORTK6     6
+#define PL6        6
+#define PINL6      6
+#define DDL6       6
+#define PORTL6     6
+#define PA7        7
+#define PINA7      7
+#define DDA7       7
+#define PORTA7     7
+#define PB7        7
+#define PINB7      7
+#define DDB7       7
+#define PORTB7     7
+#define PC7        7
+#define PINC7      7
+#define DDC7       7
+#define PORTC7     7
+#define PD7        7
+#define PIND7      7
+#define DDD7       7
+#define PORTD7     7
+#define PE7        7
+#define PINE7      7
+#define DDE7       7
+#define PORTE7     7
+#define PF7        7
+#define PINF7      7
+#define DDF7       7
+#define PORTF7     7
+#define PG7        7
+#define PING7      7
+#define DDG7       7
+#define PORTG7     7
+#define PH7        7
+#define PINH7      7
+#define DDH7       7
+#define PORTH7     7
+#define PJ7        7
+#define PINJ7      7
+#define DDJ7       7
+#define PORTJ7     7
+#define PK7        7
+#define PINK7      7
+#define DDK7       7
+#define PORTK7     7
+#define PL7        7
+#define PINL7      7
+#define DDL7       7
+#define PORTL7     7
+#define RXC0       7
+#define TXC0       6
+#define UDRE0      5
+#define FE0        4
+#define DOR0       3
+#define UPE0       2
+#define U2X0       1
+#define MPCM0      0
+#define RXCIE0     7
+#define TXCIE0     6
+#define UDRIE0     5
+#define RXEN0      4
+#define TXEN0      3
+#define UCSZ02     2
+#define RXB80      1
+#define TXB80      0
+#define UMSEL01    7
+#define UMSEL00    6
+#define UPM01      5
+#define UPM00      4
+#define USBS0      3
+#define UCSZ01     2
+#define UCSZ00     1
+#define UCPOL0     0
+#define REFS1      7
+#define REFS0      6
+#define ADLAR      5
+#define MUX4       4
+#define MUX3       3
+#define MUX2       2
+#define MUX1       1
+#define MUX0       0
+#define ADEN       7
+#define ADSC       6
+#define ADATE      5
+#define ADIF       4
+#define ADIE       3
+#define ADPS2      2
+#define ADPS1      1
+#define ADPS0      0
+#define ACME       6
+#define MUX5       3
+#define ADTS2      2
+#define ADTS1      1
+#define ADTS0      0
+#define PRTWI      7
+#define PRTIM2     6
+#define PRTIM0     5
+#define PRTIM1     3
+#define PRSPI      2
+#define PRUSART0   1
+#define PRADC      0
+#define PRTIM5     5
+#define PRTIM4     4
+#define PRTIM3     3
+#define PRUSART3   2
+#define PRUSART2   1
+#define PRUSART1   0
+#define SM2        3
+#define SM1        2
+#define SM0        1
+#define SE         0
+#define TSM        7
+#define PSRASY     1
+#define PSRSYNC    0
+#define PCIE0      0
+#define PCIE1      1
+#define PCIE2      2
+#define PCIF0      0
+#define PCIF1      1
+#define PCIF2      2
+#define COM0A1     7
+#define COM0A0     6
+#define COM0B1     5
+#define COM0B0     4
+#define WGM01      1
+#define WGM00      0
+#define FOC0A      7
+#define FOC0B      6
+#define WGM02      3
+#define CS02       2
+#define CS01       1
+#define CS00       0
+#define OCIE0B     2
+#define OCIE0A     1
+#define TOIE0      0
+#define OCF0B      2
+#define OCF0A      1
+#define TOV0       0
+#define COM2A1     7
+#define COM2A0     6
+#define COM2B1     5
+#define COM2B0     4
+#define WGM21      1
+#define WGM20      0
+#define WGM22      3
+#define CS22       2
+#define CS21       1
+#define CS20       0
+#define OCIE2B     2
+#define OCIE2A     1
+#define TOIE2      0
+#define OCF2B      2
+#define OCF2A      1
+#define TOV2       0
+#define ADC0D      0
+#define ADC8D      0
+#define PCINT0     0
+#define PCINT8     0
+#define PCINT16    0
+#define ADC1D      1
+#define ADC9D      1
+#define PCINT1     1
+#define PCINT9     1
+#define PCINT17    1
+#define ADC2D      2
+#define ADC10D     2
+#define PCINT2     2
+#define PCINT10    2
+#define PCINT18    2
+#define ADC3D      3
+#define ADC11D     3
+#define PCINT3     3
+#define PCINT11    3
+#define PCINT19    3
+#define ADC4D      4
+#define ADC12D     4
+#define PCINT4     4
+#define PCINT12    4
+#define PCINT20    4
+#define ADC5D      5
+#define ADC13D     5
+#define PCINT5     5
+#define PCINT13    5
+#define PCINT21    5
+#define ADC6D      6
+#define ADC14D     6
+#define PCINT6     6
+#define PCINT14    6
+#define PCINT22    6
+#define ADC7D      7
+#define ADC15D     7
+#define PCINT7     7
+#define PCINT15    7
+#define PCINT23    7
+#define COM1A1     7
+#define COM1A0     6
+#define COM1B1     5
+#define COM1B0     4
+#define COM1C1     3
+#define COM1C0     2
+#define WGM11      1
+#define WGM10      0
+#define ICNC1      7
+#define ICES1      6
+#define WGM13      4
+#define WGM12      3
+#define CS12       2
+#define CS11       1
+#define CS10       0
+#define FOC1A      7
+#define FOC1B      6
+#define FOC1C      5
+#define ICIE1      5
+#define OCIE1C     3
+#define OCIE1B     2
+#define OCIE1A     1
+#define TOIE1      0
+#define ICF1       5
+#define OCF1C      3
+#define OCF1B      2
+#define OCF1A      1
+#define TOV1       0
+#define COM3A1     7
+#define COM3A0     6
+#define COM3B1     5
+#define COM3B0     4
+#define COM3C1     3
+#define COM3C0     2
+#define WGM31      1
+#define WGM30      0
+#define ICNC3      7
+#define ICES3      6
+#define WGM33      4
+#define WGM32      3
+#define CS32       2
+#define CS31       1
+#define CS30       0
+#define FOC3A      7
+#define FOC3B      6
+#define FOC3C      5
+#define ICIE3      5
+#define OCIE3C     3
+#define OCIE3B     2
+#define OCIE3A     1
+#define TOIE3      0
+#define ICF3       5
+#define OCF3C      3
+#define OCF3B      2
+#define OCF3A      1
+#define TOV3       0
+#define COM4A1     7
+#define COM4A0     6
+#define COM4B1     5
+#define COM4B0     4
+#define COM4C1     3
+#define COM4C0     2
+#define WGM41      1
+#define WGM40      0
+#define ICNC4      7
+#define ICES4      6
+#define WGM43      4
+#define WGM42      3
+#define CS42       2
+#define CS41       1
+#define CS40       0
+#define FOC4A      7
+#define FOC4B      6
+#define FOC4C      5
+#define ICIE4      5
+#define OCIE4C     3
+#define OCIE4B     2
+#define OCIE4A     1
+#define TOIE4      0
+#define ICF4       5
+#define OCF4C      3
+#define OCF4B      2
+#define OCF4A      1
+#define TOV4       0
+#define COM5A1     7
+#define COM5A0     6
+#define COM5B1     5
+#define COM5B0     4
+#define COM5C1     3
+#define COM5C0     2
+#define WGM51      1
+#define WGM50      0
+#define ICNC5      7
+#define ICES5      6
+#define WGM53      4
+#define WGM52      3
+#define CS52       2
+#define CS51       1
+#define CS50       0
+#define FOC5A      7
+#define FOC5B      6
+#define FOC5C      5
+#define ICIE5      5
+#define OCIE5C     3
+#define OCIE5B     2
+#define OCIE5A     1
+#define TOIE5      0
+#define ICF5       5
+#define OCF5C      3
+#define OCF5B      2
+#define OCF5A      1
+#define TOV5       0
+#define AS2        5
+#define ACD        7
+#define SPE        6
+#define TWEN       2
+
+#endif
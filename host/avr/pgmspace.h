@@ -0,0 +1,14 @@
+/*
+  avr/pgmspace.h for the host build: there is one address space, flash
+  data is an ordinary const array and pgm_read_*() a plain read.
+*/
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(address)  (*(const unsigned char*)(address))
+#define pgm_read_word(address)  (*(const unsigned short*)(address))
+
+#endif
@@ -0,0 +1,23 @@
+/*
+  avr/sleep.h for the host build: the SMCR writes are the same as avr-libc's,
+  sleep_cpu() returns at once.
+*/
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#include "io.h"
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_ADC          (1<<SM0)
+#define SLEEP_MODE_PWR_DOWN     (1<<SM1)
+#define SLEEP_MODE_PWR_SAVE     (1<<SM1 | 1<<SM0)
+#define SLEEP_MODE_STANDBY      (1<<SM2 | 1<<SM1)
+#define SLEEP_MODE_EXT_STANDBY  (1<<SM2 | 1<<SM1 | 1<<SM0)
+
+#define set_sleep_mode(mode)    (SMCR = (SMCR & ~(1<<SM2 | 1<<SM1 | 1<<SM0)) | (mode))
+#define sleep_enable()          (SMCR |= (1<<SE))
+#define sleep_disable()         (SMCR &= ~(1<<SE))
+#define sleep_cpu()             ((void)0)
+
+#endif
@@ -0,0 +1,71 @@
+/*
+  bench.c
+
+  Runs one operation under host_io's counters and prints one line per
+  operation, all numbers per call.
+*/
+
+#include <stdio.h>
+
+#include "bench.h"
+
+#define BENCH_REGS_SHOWN    6   // most used registers listed per operation
+
+static unsigned long bench_cpu_hz;
+
+void BENCH_Init(const char *sFirmware, unsigned long iCpuHz)
+{
+    bench_cpu_hz = iCpuHz;
+    HOST_Init();
+    printf("\n%s (F_CPU %lu Hz), per call:\n", sFirmware, iCpuHz);
+    printf("%-34s %6s %7s %7s %6s %8s %8s %9s  %s\n",
+           "operation", "calls", "reads", "writes", "ext", "insns", "delay", "cycles", "registers (r/w)");
+}
+
+void BENCH_Run(const char *sName, unsigned int iCalls, void (*setup)(void), void (*op)(void))
+{
+    HOST_Counts counts;
+    double delay_cycles, n = iCalls;
+    unsigned char shown[HOST_IO_SIZE] = {0};
+    unsigned int best;
+    unsigned long best_count, count;
+
+    HOST_Begin();
+    for (unsigned int i = 0; i < iCalls; i++)
+    {
+        if (setup)
+        {
+            host_quiet = 1;
+            setup();
+            host_quiet = 0;
+        }
+        op();
+    }
+    HOST_End(&counts);
+
+    delay_cycles = counts.delay_us * (bench_cpu_hz / 1000000.0);
+    printf("%-34s %6u %7.1f %7.1f %6.1f %8.1f %8.0f %9.1f ",
+           sName, iCalls, counts.reads / n, counts.writes / n, counts.ext / n, counts.insns / n,
+           delay_cycles / n, (counts.insns + counts.ext + delay_cycles) / n);
+
+    // the registers with the most accesses
+    for (unsigned char k = 0; k < BENCH_REGS_SHOWN; k++)
+    {
+        best_count = 0;
+        for (unsigned int addr = 0; addr < HOST_IO_SIZE; addr++)
+        {
+            count = host_reg_reads[addr] + host_reg_writes[addr];
+            if (!shown[addr] && count > best_count)
+            {
+                best = addr;
+                best_count = count;
+            }
+        }
+        if (best_count == 0) {
+            break;
+        }
+        shown[best] = 1;
+        printf(" %s %g/%g", HOST_RegName(best), host_reg_reads[best] / n, host_reg_writes[best] / n);
+    }
+    printf("\n");
+}
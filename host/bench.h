@@ -0,0 +1,24 @@
+/*
+  bench.h
+
+  Benchmark runner for the host build (see host_io.h for what is counted).
+  Each bench_<firmware>.c includes the firmware source with its main()
+  renamed, so the drivers, ISR bodies and tasks are called exactly as they
+  are on the board, and lists its operations:
+
+    BENCH_Init("alarm", F_CPU);
+    BENCH_Run("LCD_SetCursorPosition", 100, NULL, bench_cursor);
+
+  setup (may be NULL) runs before every call and is not counted, it puts the
+  state and the input registers back the way the operation expects them.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "host_io.h"
+
+void BENCH_Init(const char *sFirmware, unsigned long iCpuHz);
+void BENCH_Run(const char *sName, unsigned int iCalls, void (*setup)(void), void (*op)(void));
+
+#endif
@@ -0,0 +1,60 @@
+/*
+  bench_adc.c
+
+  Host benchmark of the ADC firmware: the scan / oversampling / watchdog
+  ISR and the block statistics (see bench.h).
+*/
+
+#define main adc_main
+#define asm(x)
+#include "../ADC/adc_main.c"
+#undef main
+#undef asm
+
+#include "bench.h"
+
+#define BENCH_CALLS     100
+
+ADC_Event bench_event;
+unsigned int bench_sample = 0;
+volatile unsigned long bench_sink; // keeps results the compiler could otherwise drop
+
+// - - - - - - - - - - - - - - - - -
+// setup (not counted)
+void bench_next_sample()
+{
+    bench_sample = (bench_sample + 37) & 0x3FF; // walks through the range, crosses the thresholds
+    ADC = bench_sample;
+}
+
+void bench_one_event()
+{
+    adc_event_head = adc_event_tail = 0;
+    adc_events[0].entry = 0;
+    adc_event_head = 1;
+}
+
+// - - - - - - - - - - - - - - - - -
+// operations
+void bench_adc_isr()        { ADC_vect(); }
+void bench_process_block()  { ADC_ProcessBlock(adc_block[0], &adc_stats); }
+void bench_isqrt()          { bench_sink = isqrt32(bench_sink + 1046529UL); }
+void bench_get_event()      { bench_sink = ADC_GetEvent(&bench_event); }
+void bench_latest()         { bench_sink = ADC_Latest(0); }
+
+int main()
+{
+    init_adc();
+    init_timer1();
+    USART0_SETUP_9600_BAUD();
+    ADC_SetThresholds(0, 100, 900, 20);
+    sei();
+
+    BENCH_Init("adc", F_CPU);
+    BENCH_Run("ADC_vect (average over the scan)", BENCH_CALLS * 10, bench_next_sample, bench_adc_isr);
+    BENCH_Run("ADC_ProcessBlock (64 samples)", BENCH_CALLS, NULL, bench_process_block);
+    BENCH_Run("isqrt32", BENCH_CALLS, NULL, bench_isqrt);
+    BENCH_Run("ADC_GetEvent (1 event)", BENCH_CALLS, bench_one_event, bench_get_event);
+    BENCH_Run("ADC_Latest", BENCH_CALLS, NULL, bench_latest);
+    return 0;
+}
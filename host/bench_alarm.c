@@ -0,0 +1,177 @@
+/*
+  bench_alarm.c
+
+  Host benchmark of the alarm firmware: LCD, keypad, USART, scheduler and
+  sonar drivers, their ISRs and the alarm tasks (see bench.h). The number
+  formatting of format.h is compared with the sprintf() it replaced (the
+  host's sprintf, a stand-in for avr-libc's vfprintf).
+*/
+
+#include <stdio.h>
+
+#define main alarm_main
+#define asm(x)
+#include "../ALARM_SYSTEM_SONAR/cwk_src_code/main.c"
+#undef main
+#undef asm
+
+#include "bench.h"
+
+#define BENCH_CALLS     100
+#define BENCH_ECHO_CM   20
+#define BENCH_ECHO_COUNTS   (BENCH_ECHO_CM * SONAR_US_PER_CM / SONAR_US_PER_COUNT)
+
+char bench_text[] = "Enter passcode: "; // one LCD row
+volatile unsigned long bench_sink; // keeps results the compiler could otherwise drop
+volatile unsigned int bench_uint = 54321;
+volatile unsigned long bench_ulong = 4000000000UL;
+char bench_number[12];
+
+// - - - - - - - - - - - - - - - - -
+// setup: put the state back before every call (not counted)
+void bench_lcd_empty()
+{
+    lcd_queue_head = lcd_queue_tail = 0;
+}
+
+void bench_lcd_full()
+{
+    lcd_queue_head = lcd_queue_tail = 0;
+    LCD_WriteString(bench_text);
+}
+
+void bench_fb_one_cell()
+{
+    lcd_queue_head = lcd_queue_tail = 0;
+    memcpy(lcd_fb_shown, lcd_fb, sizeof(lcd_fb));
+    lcd_fb[0][5] ^= 0x01;
+}
+
+void bench_no_key()
+{
+    PINC = 0x0F; // column pull-ups, nothing pressed
+}
+
+void bench_echo_rising()
+{
+    sonar[0].echo_state = SONAR_WAIT_RISING;
+    TCCR4B |= (1<<ICES4);
+    ICR4 = 100;
+    TCNT4 = 110;
+}
+
+void bench_echo_falling()
+{
+    sonar[0].echo_state = SONAR_WAIT_FALLING;
+    sonar[0].rising = 100;
+    sonar[0].raw_head = sonar[0].raw_tail = 0;
+    TCCR4B &= ~(1<<ICES4);
+    ICR4 = 100 + BENCH_ECHO_COUNTS;
+    TCNT4 = ICR4 + 10;
+}
+
+void bench_gate()
+{
+    sonar[0].echo_state = SONAR_WAIT_FALLING;
+    sonar[0].raw_head = sonar[0].raw_tail = 0;
+}
+
+void bench_one_sample()
+{
+    sonar[0].raw_head = sonar[0].raw_tail = 0;
+    SONAR_Push(&sonar[0], BENCH_ECHO_COUNTS, 10);
+}
+
+void bench_tx_empty()
+{
+    usart0_tx_head = usart0_tx_tail = 0;
+}
+
+void bench_tx_one_byte()
+{
+    usart0_tx_head = usart0_tx_tail = 0;
+    USART0_TX_SingleByte('x');
+}
+
+void bench_rx_byte()
+{
+    usart0_rx_head = usart0_rx_tail = 0;
+    UCSR0A = (1<<U2X0);
+    UDR0 = 'd';
+}
+
+void bench_key_event()
+{
+    keypad_events[keypad_event_head] = 5;
+    keypad_event_head = (keypad_event_head + 1) & KEYPAD_EVENT_MASK;
+    KeyPresses = 0;
+    set_disarm_flag = 0;
+}
+
+// - - - - - - - - - - - - - - - - -
+// operations
+void bench_lcd_cursor()     { LCD_SetCursorPosition(4, BottomRow); }
+void bench_lcd_string()     { LCD_WriteString(bench_text); }
+void bench_lcd_service()    { LCD_Service(); }
+void bench_fb_flush()       { bench_sink = LCD_FB_Flush(); }
+void bench_keypad_scan()    { bench_sink = KEYPAD_ScanMatrix(); }
+void bench_keypad_isr()     { TIMER2_COMPA_vect(); }
+void bench_capture_isr()    { TIMER4_CAPT_vect(); }
+void bench_gate_isr()       { TIMER4_COMPC_vect(); }
+void bench_sonar_process()  { SONAR_Process(); }
+void bench_tick_isr()       { TIMER0_COMPA_vect(); }
+void bench_sched_run()      { SCHED_Run(); }
+void bench_tx_string()      { USART0_TX_String(bench_text); }
+void bench_udre_isr()       { USART0_UDRE_vect(); }
+void bench_rx_isr()         { USART0_RX_vect(); }
+void bench_sprintf_uint()   { sprintf(bench_number, "%u", bench_uint); }
+void bench_fmt_uint()       { FMT_Uint(bench_number, bench_uint); }
+void bench_sprintf_ulong()  { sprintf(bench_number, "%lu", bench_ulong); }
+void bench_fmt_ulong()      { FMT_Ulong(bench_number, bench_ulong); }
+
+int main()
+{
+    // the start of the firmware's main(), without the main loop
+    InitialiseGeneral();
+    LCD_FB_Init();
+    SONAR_Init();
+    SONAR_SetMaxRange(SONAR_GATE_CM);
+    USART0_SETUP_9600_BAUD();
+    SCHED_Init();
+    SCHED_AddTask(serial_task, SERIAL_PERIOD);
+    SCHED_AddTask(sonar_task, SONAR_PERIOD);
+    SCHED_AddTask(keypad_task, KEYPAD_PERIOD);
+    SCHED_AddTask(alarm_task, ALARM_PERIOD);
+    SCHED_AddTask(indicator_task, INDICATOR_PERIOD);
+    display_task_id = SCHED_AddTask(display_task, DISPLAY_PERIOD);
+    sei();
+
+    BENCH_Init("alarm", F_CPU);
+    // synchronous LCD writes (before LCD_StartAsync)
+    BENCH_Run("LCD_SetCursorPosition (sync)", BENCH_CALLS, NULL, bench_lcd_cursor);
+    BENCH_Run("LCD_WriteString 16 chars (sync)", BENCH_CALLS, NULL, bench_lcd_string);
+    LCD_StartAsync();
+    BENCH_Run("LCD_WriteString 16 chars (queued)", BENCH_CALLS, bench_lcd_empty, bench_lcd_string);
+    BENCH_Run("LCD_Service (4 byte burst)", BENCH_CALLS, bench_lcd_full, bench_lcd_service);
+    BENCH_Run("LCD_FB_Flush (1 cell changed)", BENCH_CALLS, bench_fb_one_cell, bench_fb_flush);
+    BENCH_Run("KEYPAD_ScanMatrix", BENCH_CALLS, bench_no_key, bench_keypad_scan);
+    BENCH_Run("TIMER2_COMPA_vect (keypad scan)", BENCH_CALLS, bench_no_key, bench_keypad_isr);
+    BENCH_Run("TIMER4_CAPT_vect (echo rising)", BENCH_CALLS, bench_echo_rising, bench_capture_isr);
+    BENCH_Run("TIMER4_CAPT_vect (echo falling)", BENCH_CALLS, bench_echo_falling, bench_capture_isr);
+    BENCH_Run("TIMER4_COMPC_vect (range gate)", BENCH_CALLS, bench_gate, bench_gate_isr);
+    BENCH_Run("SONAR_Process (1 sample)", BENCH_CALLS, bench_one_sample, bench_sonar_process);
+    BENCH_Run("TIMER0_COMPA_vect (1 ms tick)", BENCH_CALLS, NULL, bench_tick_isr);
+    BENCH_Run("SCHED_Run (nothing due)", BENCH_CALLS, NULL, bench_sched_run);
+    BENCH_Run("USART0_TX_String 16 chars", BENCH_CALLS, bench_tx_empty, bench_tx_string);
+    BENCH_Run("USART0_UDRE_vect", BENCH_CALLS, bench_tx_one_byte, bench_udre_isr);
+    BENCH_Run("USART0_RX_vect", BENCH_CALLS, bench_rx_byte, bench_rx_isr);
+    BENCH_Run("keypad_task (1 key press)", BENCH_CALLS, bench_key_event, keypad_task);
+    BENCH_Run("alarm_task", BENCH_CALLS, NULL, alarm_task);
+    BENCH_Run("indicator_task", BENCH_CALLS, NULL, indicator_task);
+    BENCH_Run("display_task", BENCH_CALLS, bench_lcd_empty, display_task);
+    BENCH_Run("sprintf %u (5 digits)", BENCH_CALLS, NULL, bench_sprintf_uint);
+    BENCH_Run("FMT_Uint (5 digits)", BENCH_CALLS, NULL, bench_fmt_uint);
+    BENCH_Run("sprintf %lu (10 digits)", BENCH_CALLS, NULL, bench_sprintf_ulong);
+    BENCH_Run("FMT_Ulong (10 digits)", BENCH_CALLS, NULL, bench_fmt_ulong);
+    return 0;
+}
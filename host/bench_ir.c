@@ -0,0 +1,123 @@
+/*
+  bench_ir.c
+
+  Host benchmark of the IR firmware: the NEC decoder ISR edge by edge, the
+  raw capture compression and the replay ISR (see bench.h).
+*/
+
+#include <stdio.h>
+
+#define main ir_main
+#define asm(x)
+#include "../IR_rec/main.c"
+#undef main
+#undef asm
+
+#include "bench.h"
+
+#define BENCH_CALLS     100
+#define BENCH_FRAMES    4
+#define BENCH_NEC_DATA  0xF708FB04UL    // address 0x04, command 0x08
+#define BENCH_EDGES     68              // leader, 32 bits and the stop mark: 68 edges
+#define BENCH_GAP_US    40000UL         // before each frame
+
+unsigned int bench_frame[BENCH_EDGES];  // Timer4 ticks from one edge to the next, [0] = gap
+unsigned int bench_time = 0;
+unsigned char bench_edge = 0;
+IR_Event bench_event;
+volatile unsigned long bench_sink; // keeps results the compiler could otherwise drop
+
+// mark / space lengths of one NEC frame
+void bench_build_frame()
+{
+    unsigned char n = 0;
+
+    bench_frame[n++] = IR_TICKS(BENCH_GAP_US);
+    bench_frame[n++] = IR_TICKS(NEC_LEADER_MARK_US);
+    bench_frame[n++] = IR_TICKS(NEC_LEADER_SPACE_US);
+    for (unsigned char i = 0; i < 32; i++)
+    {
+        bench_frame[n++] = IR_TICKS(NEC_BIT_MARK_US);
+        bench_frame[n++] = IR_TICKS((BENCH_NEC_DATA >> i) & 1 ? NEC_ONE_SPACE_US : NEC_ZERO_SPACE_US);
+    }
+    bench_frame[n++] = IR_TICKS(NEC_BIT_MARK_US);
+}
+
+// - - - - - - - - - - - - - - - - -
+// setup (not counted)
+void bench_next_edge()
+{
+    unsigned char rising = bench_edge & 1; // even edges start a mark (receiver output goes low)
+
+    if (bench_edge == 0) {
+        bench_time = 0; // every frame from 0: Timer4 differences must not wrap (see host_io.h)
+    }
+    bench_time += bench_frame[bench_edge];
+    ICR4 = bench_time;
+    TCNT4 = bench_time + 2;
+    if (rising)
+    {
+        TCCR4B |= (1<<ICES4);
+        PINL = (1<<PL0);
+    }
+    else
+    {
+        TCCR4B &= ~(1<<ICES4);
+        PINL = 0;
+    }
+    if (++bench_edge == BENCH_EDGES) {
+        bench_edge = 0;
+    }
+}
+
+void bench_raw_frame()
+{
+    for (unsigned char i = 1; i < BENCH_EDGES; i++) {
+        ir_raw[i - 1] = bench_frame[i];
+    }
+    ir_raw_count = BENCH_EDGES - 1;
+}
+
+void bench_one_event()
+{
+    IR_Push(0x04, 0x08, 0);
+}
+
+void bench_sending()
+{
+    bench_raw_frame();
+    ir_mode = IR_MODE_SEND;
+    ir_send_index = 0;
+}
+
+// - - - - - - - - - - - - - - - - -
+// operations
+void bench_capture_isr()    { TIMER4_CAPT_vect(); }
+void bench_compress()       { bench_sink = IR_Compress(); }
+void bench_get_event()      { bench_sink = IR_GetEvent(&bench_event); }
+void bench_replay_isr()     { TIMER1_COMPA_vect(); }
+
+int main()
+{
+    unsigned char frames = 0;
+
+    InitialiseGeneral();
+    init_timer4();
+    init_ir_transmit();
+    USART0_SETUP_9600_BAUD();
+    sei();
+    bench_build_frame();
+
+    BENCH_Init("ir", F_CPU);
+    BENCH_Run("TIMER4_CAPT_vect (NEC, per edge)", BENCH_EDGES * BENCH_FRAMES, bench_next_edge, bench_capture_isr);
+    while (IR_GetEvent(&bench_event)) {
+        frames++;
+    }
+    if (frames != BENCH_FRAMES || ir_frame_errors != 0) {
+        printf("NEC decoder: %u of %u frames, %u errors\n", frames, BENCH_FRAMES, ir_frame_errors);
+    }
+    BENCH_Run("IR_GetEvent (1 event)", BENCH_CALLS, bench_one_event, bench_get_event);
+    BENCH_Run("IR_Compress (NEC frame)", BENCH_CALLS, bench_raw_frame, bench_compress);
+    BENCH_Run("TIMER1_COMPA_vect (replay step)", BENCH_CALLS, bench_sending, bench_replay_isr);
+    return 0;
+}
@@ -0,0 +1,297 @@
+/*
+  host_io.c
+
+  Register file and access counting for the host build, see host_io.h.
+  x86-64 Linux only (page protection, the trap flag and REG_ERR).
+*/
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "host_io.h"
+
+#define HOST_TF         0x100   // EFLAGS trap flag: SIGTRAP after every instruction
+#define HOST_ERR_WRITE  0x02    // page fault error code: write access
+
+volatile uint8_t host_io[HOST_IO_PAGE] __attribute__((aligned(HOST_IO_PAGE)));
+volatile unsigned char host_quiet = 0;
+double host_delay_us = 0;
+unsigned long host_reg_reads[HOST_IO_SIZE];
+unsigned long host_reg_writes[HOST_IO_SIZE];
+
+static HOST_Counts host_counts;
+static volatile unsigned char host_stepping = 0;    // count instructions
+static volatile unsigned char host_reprotect = 0;   // an access is being let through
+
+typedef struct
+{
+    unsigned int addr;
+    unsigned char size;     // 2 = low byte of a 16-bit register
+    const char *name;
+} HOST_Reg;
+
+// the registers of avr/io.h, by address
+static const HOST_Reg host_regs[] =
+{
+    { 0x020, 1, "PINA" },
+    { 0x021, 1, "DDRA" },
+    { 0x022, 1, "PORTA" },
+    { 0x023, 1, "PINB" },
+    { 0x024, 1, "DDRB" },
+    { 0x025, 1, "PORTB" },
+    { 0x026, 1, "PINC" },
+    { 0x027, 1, "DDRC" },
+    { 0x028, 1, "PORTC" },
+    { 0x029, 1, "PIND" },
+    { 0x02A, 1, "DDRD" },
+    { 0x02B, 1, "PORTD" },
+    { 0x02C, 1, "PINE" },
+    { 0x02D, 1, "DDRE" },
+    { 0x02E, 1, "PORTE" },
+    { 0x02F, 1, "PINF" },
+    { 0x030, 1, "DDRF" },
+    { 0x031, 1, "PORTF" },
+    { 0x032, 1, "PING" },
+    { 0x033, 1, "DDRG" },
+    { 0x034, 1, "PORTG" },
+    { 0x035, 1, "TIFR0" },
+    { 0x036, 1, "TIFR1" },
+    { 0x037, 1, "TIFR2" },
+    { 0x038, 1, "TIFR3" },
+    { 0x039, 1, "TIFR4" },
+    { 0x03A, 1, "TIFR5" },
+    { 0x03B, 1, "PCIFR" },
+    { 0x03C, 1, "EIFR" },
+    { 0x03D, 1, "EIMSK" },
+    { 0x043, 1, "GTCCR" },
+    { 0x044, 1, "TCCR0A" },
+    { 0x045, 1, "TCCR0B" },
+    { 0x046, 1, "TCNT0" },
+    { 0x047, 1, "OCR0A" },
+    { 0x048, 1, "OCR0B" },
+    { 0x04C, 1, "SPCR" },
+    { 0x050, 1, "ACSR" },
+    { 0x053, 1, "SMCR" },
+    { 0x055, 1, "MCUCR" },
+    { 0x05F, 1, "SREG" },
+    { 0x064, 1, "PRR0" },
+    { 0x065, 1, "PRR1" },
+    { 0x068, 1, "PCICR" },
+    { 0x069, 1, "EICRA" },
+    { 0x06A, 1, "EICRB" },
+    { 0x06B, 1, "PCMSK0" },
+    { 0x06C, 1, "PCMSK1" },
+    { 0x06D, 1, "PCMSK2" },
+    { 0x06E, 1, "TIMSK0" },
+    { 0x06F, 1, "TIMSK1" },
+    { 0x070, 1, "TIMSK2" },
+    { 0x071, 1, "TIMSK3" },
+    { 0x072, 1, "TIMSK4" },
+    { 0x073, 1, "TIMSK5" },
+    { 0x078, 2, "ADC" },
+    { 0x079, 1, "ADCH" },
+    { 0x07A, 1, "ADCSRA" },
+    { 0x07B, 1, "ADCSRB" },
+    { 0x07C, 1, "ADMUX" },
+    { 0x07D, 1, "DIDR2" },
+    { 0x07E, 1, "DIDR0" },
+    { 0x07F, 1, "DIDR1" },
+    { 0x080, 1, "TCCR1A" },
+    { 0x081, 1, "TCCR1B" },
+    { 0x082, 1, "TCCR1C" },
+    { 0x084, 2, "TCNT1" },
+    { 0x085, 1, "TCNT1H" },
+    { 0x086, 2, "ICR1" },
+    { 0x087, 1, "ICR1H" },
+    { 0x088, 2, "OCR1A" },
+    { 0x089, 1, "OCR1AH" },
+    { 0x08A, 2, "OCR1B" },
+    { 0x08B, 1, "OCR1BH" },
+    { 0x08C, 2, "OCR1C" },
+    { 0x08D, 1, "OCR1CH" },
+    { 0x090, 1, "TCCR3A" },
+    { 0x091, 1, "TCCR3B" },
+    { 0x092, 1, "TCCR3C" },
+    { 0x094, 2, "TCNT3" },
+    { 0x095, 1, "TCNT3H" },
+    { 0x096, 2, "ICR3" },
+    { 0x097, 1, "ICR3H" },
+    { 0x098, 2, "OCR3A" },
+    { 0x099, 1, "OCR3AH" },
+    { 0x09A, 2, "OCR3B" },
+    { 0x09B, 1, "OCR3BH" },
+    { 0x09C, 2, "OCR3C" },
+    { 0x09D, 1, "OCR3CH" },
+    { 0x0A0, 1, "TCCR4A" },
+    { 0x0A1, 1, "TCCR4B" },
+    { 0x0A2, 1, "TCCR4C" },
+    { 0x0A4, 2, "TCNT4" },
+    { 0x0A5, 1, "TCNT4H" },
+    { 0x0A6, 2, "ICR4" },
+    { 0x0A7, 1, "ICR4H" },
+    { 0x0A8, 2, "OCR4A" },
+    { 0x0A9, 1, "OCR4AH" },
+    { 0x0AA, 2, "OCR4B" },
+    { 0x0AB, 1, "OCR4BH" },
+    { 0x0AC, 2, "OCR4C" },
+    { 0x0AD, 1, "OCR4CH" },
+    { 0x0B0, 1, "TCCR2A" },
+    { 0x0B1, 1, "TCCR2B" },
+    { 0x0B2, 1, "TCNT2" },
+    { 0x0B3, 1, "OCR2A" },
+    { 0x0B4, 1, "OCR2B" },
+    { 0x0B6, 1, "ASSR" },
+    { 0x0BC, 1, "TWCR" },
+    { 0x0C0, 1, "UCSR0A" },
+    { 0x0C1, 1, "UCSR0B" },
+    { 0x0C2, 1, "UCSR0C" },
+    { 0x0C4, 1, "UBRR0L" },
+    { 0x0C5, 1, "UBRR0H" },
+    { 0x0C6, 1, "UDR0" },
+    { 0x0C9, 1, "UCSR1B" },
+    { 0x0D1, 1, "UCSR2B" },
+    { 0x100, 1, "PINH" },
+    { 0x101, 1, "DDRH" },
+    { 0x102, 1, "PORTH" },
+    { 0x103, 1, "PINJ" },
+    { 0x104, 1, "DDRJ" },
+    { 0x105, 1, "PORTJ" },
+    { 0x106, 1, "PINK" },
+    { 0x107, 1, "DDRK" },
+    { 0x108, 1, "PORTK" },
+    { 0x109, 1, "PINL" },
+    { 0x10A, 1, "DDRL" },
+    { 0x10B, 1, "PORTL" },
+    { 0x120, 1, "TCCR5A" },
+    { 0x121, 1, "TCCR5B" },
+    { 0x122, 1, "TCCR5C" },
+    { 0x124, 2, "TCNT5" },
+    { 0x125, 1, "TCNT5H" },
+    { 0x126, 2, "ICR5" },
+    { 0x127, 1, "ICR5H" },
+    { 0x128, 2, "OCR5A" },
+    { 0x129, 1, "OCR5AH" },
+    { 0x12A, 2, "OCR5B" },
+    { 0x12B, 1, "OCR5BH" },
+    { 0x12C, 2, "OCR5C" },
+    { 0x12D, 1, "OCR5CH" },
+    { 0x131, 1, "UCSR3B" },
+};
+
+static const HOST_Reg *HOST_FindReg(unsigned int addr)
+{
+    for (unsigned int i = 0; i < sizeof(host_regs) / sizeof(host_regs[0]); i++)
+    {
+        if (host_regs[i].addr == addr) {
+            return &host_regs[i];
+        }
+    }
+    return NULL;
+}
+
+const char *HOST_RegName(unsigned int addr)
+{
+    const HOST_Reg *reg = HOST_FindReg(addr);
+    return reg ? reg->name : "?";
+}
+
+static void HOST_Protect(int prot)
+{
+    mprotect((void *)host_io, HOST_IO_PAGE, prot);
+}
+
+// A register access: count it, then let the instruction run with the page open
+static void HOST_Fault(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+    const HOST_Reg *reg;
+    unsigned int addr, size;
+
+    if ((volatile uint8_t *)info->si_addr < host_io
+        || (volatile uint8_t *)info->si_addr >= host_io + HOST_IO_PAGE)
+    {
+        signal(sig, SIG_DFL); // a real crash, fault again without the handler
+        return;
+    }
+    addr = (volatile uint8_t *)info->si_addr - host_io;
+    if (!host_quiet && addr < HOST_IO_SIZE)
+    {
+        reg = HOST_FindReg(addr);
+        size = reg ? reg->size : 1;
+        if (uc->uc_mcontext.gregs[REG_ERR] & HOST_ERR_WRITE)
+        {
+            host_reg_writes[addr] += size;
+            host_counts.writes += size;
+        }
+        else
+        {
+            host_reg_reads[addr] += size;
+            host_counts.reads += size;
+        }
+        if (addr >= HOST_IO_EXT) {
+            host_counts.ext += size;
+        }
+    }
+    HOST_Protect(PROT_READ | PROT_WRITE);
+    host_reprotect = 1;
+    uc->uc_mcontext.gregs[REG_EFL] |= HOST_TF;
+}
+
+// After every instruction while stepping, and after a let-through access
+static void HOST_Step(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    if (host_reprotect)
+    {
+        host_reprotect = 0;
+        HOST_Protect(PROT_NONE);
+    }
+    if (host_stepping)
+    {
+        if (!host_quiet) {
+            host_counts.insns++;
+        }
+    }
+    else {
+        uc->uc_mcontext.gregs[REG_EFL] &= ~HOST_TF;
+    }
+}
+
+void HOST_Init()
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = HOST_Fault;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = HOST_Step;
+    sigaction(SIGTRAP, &sa, NULL);
+}
+
+// Start counting register accesses and instructions
+void HOST_Begin()
+{
+    memset(&host_counts, 0, sizeof(host_counts));
+    memset(host_reg_reads, 0, sizeof(host_reg_reads));
+    memset(host_reg_writes, 0, sizeof(host_reg_writes));
+    host_delay_us = 0;
+    host_quiet = 0;
+    HOST_Protect(PROT_NONE);
+    host_stepping = 1;
+    __asm__ volatile ("pushfq; orq %0, (%%rsp); popfq" : : "i" (HOST_TF) : "cc", "memory");
+}
+
+// Stop counting, pCounts = totals since HOST_Begin()
+void HOST_End(HOST_Counts *pCounts)
+{
+    host_stepping = 0;  // the next SIGTRAP clears the trap flag
+    HOST_Protect(PROT_READ | PROT_WRITE);
+    host_counts.delay_us = host_delay_us;
+    *pCounts = host_counts;
+}
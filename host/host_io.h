@@ -0,0 +1,75 @@
+/*
+  host_io.h
+
+  Host (x86-64 Linux) stand-in for the ATmega2560 register file, used by the
+  benchmark runner (make bench). The firmware sources compile unchanged
+  against the headers in host/avr and host/util: every register name is a
+  byte of host_io[] at its data space address (PORTA = 0x22, UDR0 = 0xC6,
+  TCNT4 = 0xA4 ...).
+
+  host_io[] is a page of its own. While a measurement runs the page is
+  protected, so every register access faults: HOST_Fault() counts it as a
+  read or a write, lets the instruction run and HOST_Step() protects the
+  page again. This also catches accesses through pointers (the sonar
+  channel table). The same single-step trap counts the host instructions
+  of the measured code, a stand-in for its AVR instruction count.
+  - - - - - - - - - - - - - - - - -
+  Estimates per call (printed by BENCH_Run()):
+    reads / writes  register accesses, a 16-bit register counts as 2 bytes
+    ext             accesses above 0x5F (lds / sts, one cycle more than in / out)
+    insns           host instructions executed (x86, same order as AVR for
+                    8-bit code, fewer for 16/32-bit arithmetic)
+    delay           _delay_us() / _delay_ms() time in CPU cycles at F_CPU
+    cycles          insns + ext + delay
+  These are for spotting regressions, the cycle-accurate numbers come from
+  running the .elf in the simulator (make sim, see sim.h).
+  int is 32 bits on the host: stimuli must not make 16-bit timer
+  differences wrap (now - last is only modulo 65536 on the AVR).
+  A read-modify-write (PORTG |= x) counts as one read and one write, like
+  in / out; sbi / cbi would be a single access on the AVR.
+  - - - - - - - - - - - - - - - - -
+  Stimuli are written without being counted:
+    HOST_Set(PINC, 0x0E);
+*/
+
+#ifndef HOST_IO_H
+#define HOST_IO_H
+
+#include <stdint.h>
+
+#define HOST_IO_SIZE    0x200   // data space up to the last extended I/O register
+#define HOST_IO_PAGE    4096
+#define HOST_IO_EXT     0x60    // first address that needs lds / sts
+
+extern volatile uint8_t host_io[HOST_IO_PAGE];
+extern volatile unsigned char host_quiet;   // 1 = accesses, instructions and delays are not counted
+extern double host_delay_us;
+
+#define HOST_REG8(addr)     (*(volatile uint8_t *)&host_io[addr])
+#define HOST_REG16(addr)    (*(volatile uint16_t *)&host_io[addr])
+
+// write a register without counting it (stimulus, and the I bit for sei() / cli())
+#define HOST_Set(reg, value) do { \
+        unsigned char host_was_quiet = host_quiet; \
+        host_quiet = 1; \
+        (reg) = (value); \
+        host_quiet = host_was_quiet; \
+    } while (0)
+
+typedef struct
+{
+    unsigned long reads, writes;    // register bytes
+    unsigned long ext;              // of those, in the extended I/O space
+    unsigned long insns;            // host instructions
+    double delay_us;
+} HOST_Counts;
+
+extern unsigned long host_reg_reads[HOST_IO_SIZE];
+extern unsigned long host_reg_writes[HOST_IO_SIZE];
+
+void HOST_Init();
+void HOST_Begin();
+void HOST_End(HOST_Counts *pCounts);
+const char *HOST_RegName(unsigned int addr);
+
+#endif
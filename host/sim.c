@@ -0,0 +1,380 @@
+/*
+  sim.c
+
+  simavr set-up, stimulus helpers, ISR cycle accounting and the JSON
+  report, see sim.h.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_time.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/sim_interrupts.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_adc.h>
+
+#include "sim.h"
+
+#define SIM_VECTORS     57      // ATmega2560, RESET included
+#define SIM_NESTING     8       // interrupts running inside each other
+#define SIM_RESULTS     32
+#define SIM_VCC_MV      5000    // VCC, AVCC and AREF of the board
+
+avr_t *sim_avr;
+char sim_uart_log[SIM_UART_LOG_SIZE];
+unsigned int sim_uart_length = 0;
+
+// vector number -> name, as in avr/iom2560.h without _vect
+static const char *sim_vector_names[SIM_VECTORS] =
+{
+    "RESET", "INT0", "INT1", "INT2", "INT3", "INT4", "INT5", "INT6", "INT7",
+    "PCINT0", "PCINT1", "PCINT2", "WDT",
+    "TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF",
+    "TIMER1_CAPT", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_COMPC", "TIMER1_OVF",
+    "TIMER0_COMPA", "TIMER0_COMPB", "TIMER0_OVF",
+    "SPI_STC", "USART0_RX", "USART0_UDRE", "USART0_TX", "ANALOG_COMP", "ADC", "EE_READY",
+    "TIMER3_CAPT", "TIMER3_COMPA", "TIMER3_COMPB", "TIMER3_COMPC", "TIMER3_OVF",
+    "USART1_RX", "USART1_UDRE", "USART1_TX", "TWI", "SPM_READY",
+    "TIMER4_CAPT", "TIMER4_COMPA", "TIMER4_COMPB", "TIMER4_COMPC", "TIMER4_OVF",
+    "TIMER5_CAPT", "TIMER5_COMPA", "TIMER5_COMPB", "TIMER5_COMPC", "TIMER5_OVF",
+    "USART2_RX", "USART2_UDRE", "USART2_TX", "USART3_RX", "USART3_UDRE", "USART3_TX",
+};
+
+typedef struct
+{
+    unsigned long calls;
+    avr_cycle_count_t min, max, total;
+} SIM_Isr;
+
+typedef struct
+{
+    const char *name;
+    double value;
+    const char *unit;
+} SIM_Value;
+
+typedef struct
+{
+    void (*event)(void *param);
+    void *param;
+} SIM_Timer;
+
+typedef struct
+{
+    void (*changed)(unsigned char iLevel);
+    int level;              // -1 = not seen yet
+} SIM_PinWatch;
+
+static const char *sim_firmware;
+static const char *sim_elf;
+static unsigned long sim_cpu_hz;
+static avr_cycle_count_t sim_start;     // cycle count after loading
+
+static SIM_Isr sim_isr[SIM_VECTORS];
+static unsigned char sim_isr_stack[SIM_NESTING];    // vectors running, innermost last
+static avr_cycle_count_t sim_isr_cycles[SIM_NESTING]; // cycles of each so far
+static unsigned char sim_isr_depth = 0;
+static avr_cycle_count_t sim_isr_mark;  // start of the current stretch
+
+static SIM_Value sim_results[SIM_RESULTS];
+static unsigned char sim_result_count = 0;
+
+static void (*sim_uart_received)(unsigned char cByte);
+
+// - - - - - - - - - - - - - - - - -
+// simavr 'interrupt running' signal: the vector now executing, 0 = none
+static void sim_isr_running(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    avr_cycle_count_t now = sim_avr->cycle;
+    SIM_Isr *pIsr;
+    unsigned char vector;
+
+    if (sim_isr_depth > 0) {
+        sim_isr_cycles[sim_isr_depth - 1] += now - sim_isr_mark;
+    }
+    sim_isr_mark = now;
+
+    if ((value == 0 && sim_isr_depth == 1)
+        || (sim_isr_depth >= 2 && value == sim_isr_stack[sim_isr_depth - 2]))
+    {
+        // reti: back to the main program or to the interrupted ISR
+        sim_isr_depth--;
+        vector = sim_isr_stack[sim_isr_depth];
+        if (vector < SIM_VECTORS)
+        {
+            pIsr = &sim_isr[vector];
+            if (pIsr->calls == 0 || sim_isr_cycles[sim_isr_depth] < pIsr->min) {
+                pIsr->min = sim_isr_cycles[sim_isr_depth];
+            }
+            if (sim_isr_cycles[sim_isr_depth] > pIsr->max) {
+                pIsr->max = sim_isr_cycles[sim_isr_depth];
+            }
+            pIsr->total += sim_isr_cycles[sim_isr_depth];
+            pIsr->calls++;
+        }
+    }
+    else if (value != 0 && sim_isr_depth < SIM_NESTING)
+    {
+        sim_isr_stack[sim_isr_depth] = value;
+        sim_isr_cycles[sim_isr_depth] = 0;
+        sim_isr_depth++;
+    }
+}
+
+static void sim_uart_output(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if (sim_uart_length < SIM_UART_LOG_SIZE - 1) {
+        sim_uart_log[sim_uart_length++] = value;
+    }
+    if (sim_uart_received) {
+        sim_uart_received(value);
+    }
+}
+
+static void sim_pin_changed(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    SIM_PinWatch *pWatch = param;
+
+    value = (value != 0);
+    if (pWatch->level != (int)value)
+    {
+        pWatch->level = value;
+        pWatch->changed(value);
+    }
+}
+
+static void sim_port_written(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    ((SIM_PinWatch *)param)->changed(value);
+}
+
+static avr_cycle_count_t sim_timer_fired(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+    SIM_Timer *pTimer = param;
+
+    pTimer->event(pTimer->param);
+    free(pTimer);
+    return 0; // once
+}
+
+// - - - - - - - - - - - - - - - - -
+// load the image, the CPU clock is not in the .elf (no .mmcu section)
+avr_t *SIM_Load(const char *sElf, unsigned long iCpuHz, const char *sFirmware)
+{
+    elf_firmware_t firmware;
+    uint32_t flags = 0;
+
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(sElf, &firmware) != 0)
+    {
+        fprintf(stderr, "sim: cannot read %s\n", sElf);
+        exit(1);
+    }
+    strcpy(firmware.mmcu, "atmega2560");
+    firmware.frequency = iCpuHz;
+
+    sim_avr = avr_make_mcu_by_name(firmware.mmcu);
+    if (!sim_avr)
+    {
+        fprintf(stderr, "sim: simavr has no %s core\n", firmware.mmcu);
+        exit(1);
+    }
+    avr_init(sim_avr);
+    avr_load_firmware(sim_avr, &firmware);
+    sim_avr->vcc = sim_avr->avcc = sim_avr->aref = SIM_VCC_MV;
+
+    // USART0 output goes to the report, not to the console
+    avr_ioctl(sim_avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(sim_avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_register_notify(avr_io_getirq(sim_avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+                            sim_uart_output, NULL);
+
+    avr_irq_register_notify(avr_get_interrupt_irq(sim_avr, AVR_INT_ANY) + AVR_INT_IRQ_RUNNING,
+                            sim_isr_running, NULL);
+
+    sim_firmware = sFirmware;
+    sim_elf = sElf;
+    sim_cpu_hz = iCpuHz;
+    sim_start = sim_avr->cycle;
+    return sim_avr;
+}
+
+void SIM_RunCycles(avr_cycle_count_t iCycles)
+{
+    avr_cycle_count_t end = sim_avr->cycle + iCycles;
+    int state;
+
+    while (sim_avr->cycle < end)
+    {
+        state = avr_run(sim_avr);
+        if (state == cpu_Done || state == cpu_Crashed)
+        {
+            // sleep with interrupts off, or a bad instruction / address
+            fprintf(stderr, "sim: %s stopped at cycle %llu, pc 0x%05x (%s)\n", sim_firmware,
+                    (unsigned long long)sim_avr->cycle, sim_avr->pc,
+                    state == cpu_Done ? "done" : "crashed");
+            exit(1);
+        }
+    }
+}
+
+void SIM_RunMs(unsigned long iMs)
+{
+    SIM_RunCycles(avr_usec_to_cycles(sim_avr, iMs * 1000UL));
+}
+
+avr_cycle_count_t SIM_Now()
+{
+    return sim_avr->cycle;
+}
+
+double SIM_CyclesToUs(avr_cycle_count_t iCycles)
+{
+    return iCycles * 1000000.0 / sim_cpu_hz;
+}
+
+// run event(param) iUs from now, in the middle of the simulation
+void SIM_After(unsigned long iUs, void (*event)(void *param), void *param)
+{
+    SIM_Timer *pTimer = malloc(sizeof(SIM_Timer));
+
+    pTimer->event = event;
+    pTimer->param = param;
+    avr_cycle_timer_register(sim_avr, avr_usec_to_cycles(sim_avr, iUs), sim_timer_fired, pTimer);
+}
+
+// - - - - - - - - - - - - - - - - -
+void SIM_SetPin(char cPort, unsigned char iBit, unsigned char iLevel)
+{
+    avr_raise_irq(avr_io_getirq(sim_avr, AVR_IOCTL_IOPORT_GETIRQ(cPort), iBit), iLevel);
+}
+
+// changed() is called with the new level each time the pin changes
+void SIM_OnPin(char cPort, unsigned char iBit, void (*changed)(unsigned char iLevel))
+{
+    SIM_PinWatch *pWatch = malloc(sizeof(SIM_PinWatch));
+
+    pWatch->changed = changed;
+    pWatch->level = -1;
+    avr_irq_register_notify(avr_io_getirq(sim_avr, AVR_IOCTL_IOPORT_GETIRQ(cPort), iBit),
+                            sim_pin_changed, pWatch);
+}
+
+// written() is called with the PORTx value on every write, during the write
+void SIM_OnPort(char cPort, void (*written)(unsigned char iValue))
+{
+    SIM_PinWatch *pWatch = malloc(sizeof(SIM_PinWatch));
+
+    pWatch->changed = written;
+    avr_irq_register_notify(avr_io_getirq(sim_avr, AVR_IOCTL_IOPORT_GETIRQ(cPort), IOPORT_IRQ_REG_PORT),
+                            sim_port_written, pWatch);
+}
+
+// bytes are queued in simavr's receive FIFO and arrive at the baud rate set by the firmware
+void SIM_UartSend(const char *sText)
+{
+    avr_irq_t *irq = avr_io_getirq(sim_avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    while (*sText) {
+        avr_raise_irq(irq, (unsigned char)*sText++);
+    }
+}
+
+void SIM_OnUart(void (*received)(unsigned char cByte))
+{
+    sim_uart_received = received;
+}
+
+void SIM_SetAdc(unsigned char iChannel, unsigned int iMilliVolts)
+{
+    avr_raise_irq(avr_io_getirq(sim_avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + iChannel), iMilliVolts);
+}
+
+// - - - - - - - - - - - - - - - - -
+// fValue NAN = did not happen (null in the report)
+void SIM_Result(const char *sName, double fValue, const char *sUnit)
+{
+    if (sim_result_count < SIM_RESULTS)
+    {
+        sim_results[sim_result_count].name = sName;
+        sim_results[sim_result_count].value = fValue;
+        sim_results[sim_result_count].unit = sUnit;
+        sim_result_count++;
+    }
+}
+
+static void sim_print_string(const char *sText, unsigned int iLength)
+{
+    putchar('"');
+    for (unsigned int i = 0; i < iLength; i++)
+    {
+        unsigned char c = sText[i];
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        }
+        else if (c == '\n') {
+            printf("\\n");
+        }
+        else if (c == '\r') {
+            printf("\\r");
+        }
+        else if (c < 0x20 || c >= 0x7F) {
+            printf("\\u%04x", c);
+        }
+        else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+// the whole run as one JSON object on stdout
+void SIM_Report()
+{
+    avr_cycle_count_t cycles = sim_avr->cycle - sim_start;
+    const char *sSeparator = "";
+
+    printf("{\n  \"firmware\": \"%s\",\n  \"elf\": ", sim_firmware);
+    sim_print_string(sim_elf, strlen(sim_elf));
+    printf(",\n  \"cpu_hz\": %lu,\n  \"cycles\": %llu,\n  \"isr\": [",
+           sim_cpu_hz, (unsigned long long)cycles);
+    for (unsigned char v = 1; v < SIM_VECTORS; v++)
+    {
+        SIM_Isr *pIsr = &sim_isr[v];
+        if (pIsr->calls == 0) {
+            continue;
+        }
+        printf("%s\n    { \"vector\": %u, \"name\": \"%s\", \"calls\": %lu, "
+               "\"cycles_min\": %llu, \"cycles_max\": %llu, \"cycles_mean\": %.1f, "
+               "\"cycles_total\": %llu, \"cpu_percent\": %.3f }",
+               sSeparator, v, sim_vector_names[v], pIsr->calls,
+               (unsigned long long)pIsr->min, (unsigned long long)pIsr->max,
+               (double)pIsr->total / pIsr->calls, (unsigned long long)pIsr->total,
+               cycles ? 100.0 * pIsr->total / cycles : 0.0);
+        sSeparator = ",";
+    }
+    printf("\n  ],\n  \"results\": [");
+    sSeparator = "";
+    for (unsigned char i = 0; i < sim_result_count; i++)
+    {
+        printf("%s\n    { \"name\": \"%s\", \"value\": ", sSeparator, sim_results[i].name);
+        if (isnan(sim_results[i].value)) {
+            printf("null"); // did not happen
+        }
+        else {
+            printf("%.1f", sim_results[i].value);
+        }
+        printf(", \"unit\": \"%s\" }", sim_results[i].unit);
+        sSeparator = ",";
+    }
+    printf("\n  ],\n  \"uart0\": ");
+    sim_print_string(sim_uart_log, sim_uart_length);
+    printf("\n}\n");
+}
@@ -0,0 +1,94 @@
+/*
+  sim_adc.c
+
+  The ADC firmware in simavr, see sim.h.
+    sim_adc build/os/adc.elf > build/os/sim_adc.json
+
+  Inputs (mV, AVCC = 5 V): ADC0 fast signal, ADC1 thermistor, ADC2 light
+  level, the bandgap entry reads simavr's internal 1.1 V.
+
+  Results (us):
+    print_command_to_reply  'p' queued -> first byte of the statistics,
+                            includes the byte on the line at 9600 baud
+    threshold_to_event      ADC1 steps above its high threshold -> the
+                            "ADC event 1:" line has been sent (includes its
+                            12 bytes at 9600 baud and the 1-in-100 decimation
+                            and x16 oversampling of that entry)
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define SIM_CPU_HZ          16000000UL  // F_CPU of the ADC firmware
+#define SIM_FAST_MV         2500
+#define SIM_THERMISTOR_MV   2000    // 1638 (12 bit), inside 800-3200
+#define SIM_HOT_MV          4500    // 3686, above the high threshold
+#define SIM_LIGHT_MV        3000
+#define SIM_STARTUP_MS      1000
+#define SIM_TIMEOUT_MS      5000    // a latency that has not happened by then is null
+
+static const char sim_event_text[] = "ADC event 1:";
+
+static avr_cycle_count_t sim_reply = 0;     // first USART0 byte since sim_reply was cleared
+static avr_cycle_count_t sim_event = 0;     // sim_event_text complete
+static unsigned int sim_event_from = 0;     // sim_uart_log offset to search from
+
+static void sim_uart_received(unsigned char cByte)
+{
+    if (sim_reply == 0) {
+        sim_reply = SIM_Now();
+    }
+    if (sim_event == 0 && sim_uart_length >= sim_event_from + sizeof(sim_event_text) - 1
+        && memcmp(&sim_uart_log[sim_uart_length - (sizeof(sim_event_text) - 1)],
+                  sim_event_text, sizeof(sim_event_text) - 1) == 0)
+    {
+        sim_event = SIM_Now();
+    }
+}
+
+// run until *pWhen is set after iStart, returns the latency in us (NAN on timeout)
+static double sim_wait(avr_cycle_count_t *pWhen, avr_cycle_count_t iStart)
+{
+    for (unsigned long ms = 0; ms < SIM_TIMEOUT_MS; ms++)
+    {
+        if (*pWhen > iStart) {
+            return SIM_CyclesToUs(*pWhen - iStart);
+        }
+        SIM_RunMs(1);
+    }
+    return NAN;
+}
+
+int main(int argc, char *argv[])
+{
+    avr_cycle_count_t start;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s adc.elf\n", argv[0]);
+        return 2;
+    }
+    SIM_Load(argv[1], SIM_CPU_HZ, "adc");
+    SIM_SetAdc(0, SIM_FAST_MV);
+    SIM_SetAdc(1, SIM_THERMISTOR_MV);
+    SIM_SetAdc(2, SIM_LIGHT_MV);
+    SIM_OnUart(sim_uart_received);
+    SIM_RunMs(SIM_STARTUP_MS);
+
+    sim_reply = 0;
+    start = SIM_Now();
+    SIM_UartSend("p");
+    SIM_Result("print_command_to_reply", sim_wait(&sim_reply, start), "us");
+    SIM_RunMs(500); // rest of the statistics
+
+    sim_event_from = sim_uart_length;
+    start = SIM_Now();
+    SIM_SetAdc(1, SIM_HOT_MV);
+    SIM_Result("threshold_to_event", sim_wait(&sim_event, start), "us");
+
+    SIM_Report();
+    return 0;
+}
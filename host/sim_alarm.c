@@ -0,0 +1,203 @@
+/*
+  sim_alarm.c
+
+  The alarm firmware in simavr: an HC-SR04 on sensor 0, the keypad matrix
+  and a serial terminal, see sim.h.
+    sim_alarm build/os/alarm.elf > build/os/sim_alarm.json
+
+  Sonar: every falling edge of TRIG (PH4, the end of the 16 us pulse made
+  by OC4B) starts an echo on PL0 (ICP4) SIM_ECHO_DELAY_US later, high for
+  sim_distance_cm * SIM_US_PER_CM. An object beyond the gate makes an echo
+  longer than the gate, like the real sensor.
+  Keypad: the key held down connects its row (PC7-PC4, driven low one at a
+  time by the scan) to its column (PC3-PC0), the columns read high through
+  the pull-ups otherwise.
+
+  Results (us):
+    intrusion_to_buzzer     object moves from 150 cm to 20 cm -> PK4 high.
+                            Includes the ping period, the median filter, the
+                            task periods and the buzzer's on / off phase.
+    passcode_to_disarm      the last passcode key goes down -> green LED (PK1),
+                            includes the 20 ms debounce
+    serial_command_to_reply 'stat' + CR queued -> first reply byte sent,
+                            includes the 5 bytes on the line at 9600 baud
+    buzzer_after_disarm     1 if PK4 was still high after the disarm (error)
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+
+#define SIM_CPU_HZ          1000000UL   // F_CPU of the alarm firmware
+#define SIM_ECHO_DELAY_US   600     // end of TRIG to the echo (as SONAR_ECHO_DELAY_US)
+#define SIM_US_PER_CM       59      // round trip (as SONAR_US_PER_CM)
+#define SIM_FAR_CM          150     // beyond the gate (50 cm)
+#define SIM_NEAR_CM         20      // inside the alarm zone (5-35 cm)
+#define SIM_STARTUP_MS      7000    // LCD set-up, 5 s splash screen, filters settled
+#define SIM_TIMEOUT_MS      5000    // a latency that has not happened by then is null
+#define SIM_KEY_MS          100     // key held down, and the gap after it
+#define SIM_KEY_ENTER       16      // S16 starts the passcode entry
+
+static const unsigned char sim_passcode[4] = {1, 2, 3, 4}; // the firmware's default
+
+static unsigned int sim_distance_cm = SIM_FAR_CM;
+static unsigned char sim_key = 0;               // key held down, 0 = none
+static unsigned char sim_portc = 0x0F;          // last PORTC written by the firmware
+static unsigned char sim_columns = 0xFF;        // levels driven on PC3-PC0
+
+static avr_cycle_count_t sim_buzzer_on = 0;     // last rising edge of PK4
+static unsigned char sim_buzzer = 0;
+static avr_cycle_count_t sim_green_on = 0;      // last rising edge of PK1
+static avr_cycle_count_t sim_reply = 0;         // first USART0 byte since sim_reply was cleared
+
+// - - - - - - - - - - - - - - - - -
+// HC-SR04
+static void sim_echo_end(void *param)
+{
+    SIM_SetPin('L', 0, 0);
+}
+
+static void sim_echo_start(void *param)
+{
+    SIM_SetPin('L', 0, 1);
+    SIM_After(sim_distance_cm * SIM_US_PER_CM, sim_echo_end, NULL);
+}
+
+static void sim_trigger(unsigned char iLevel)
+{
+    if (iLevel == 0) {
+        SIM_After(SIM_ECHO_DELAY_US, sim_echo_start, NULL);
+    }
+}
+
+// - - - - - - - - - - - - - - - - -
+// keypad matrix: key n = row (n - 1) / 4 (PC7 = row 0), column (n - 1) % 4 (PC3 = column 0)
+static void sim_keypad_columns()
+{
+    unsigned char columns = 0x0F;
+    unsigned char row, column;
+
+    if (sim_key != 0)
+    {
+        row = (sim_key - 1) / 4;
+        column = (sim_key - 1) % 4;
+        if (!(sim_portc & (1 << (7 - row)))) {
+            columns &= ~(1 << (3 - column));
+        }
+    }
+    for (unsigned char pin = 0; pin < 4; pin++)
+    {
+        if ((columns ^ sim_columns) & (1 << pin)) {
+            SIM_SetPin('C', pin, (columns >> pin) & 1);
+        }
+    }
+    sim_columns = columns;
+}
+
+static void sim_portc_written(unsigned char iValue)
+{
+    sim_portc = iValue;
+    sim_keypad_columns();
+}
+
+static void sim_press(unsigned char iKey)
+{
+    sim_key = iKey;
+    sim_keypad_columns();
+    SIM_RunMs(SIM_KEY_MS);
+    sim_key = 0;
+    sim_keypad_columns();
+    SIM_RunMs(SIM_KEY_MS);
+}
+
+// - - - - - - - - - - - - - - - - -
+static void sim_buzzer_changed(unsigned char iLevel)
+{
+    sim_buzzer = iLevel;
+    if (iLevel) {
+        sim_buzzer_on = SIM_Now();
+    }
+}
+
+static void sim_green_changed(unsigned char iLevel)
+{
+    if (iLevel) {
+        sim_green_on = SIM_Now();
+    }
+}
+
+static void sim_uart_received(unsigned char cByte)
+{
+    if (sim_reply == 0) {
+        sim_reply = SIM_Now();
+    }
+}
+
+// run until *pWhen is set after iStart, returns the latency in us (NAN on timeout)
+static double sim_wait(avr_cycle_count_t *pWhen, avr_cycle_count_t iStart)
+{
+    for (unsigned long ms = 0; ms < SIM_TIMEOUT_MS; ms++)
+    {
+        if (*pWhen > iStart) {
+            return SIM_CyclesToUs(*pWhen - iStart);
+        }
+        SIM_RunMs(1);
+    }
+    return NAN;
+}
+
+int main(int argc, char *argv[])
+{
+    avr_cycle_count_t start;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s alarm.elf\n", argv[0]);
+        return 2;
+    }
+    SIM_Load(argv[1], SIM_CPU_HZ, "alarm");
+    SIM_SetPin('L', 0, 0);
+    for (unsigned char pin = 0; pin < 4; pin++) {
+        SIM_SetPin('C', pin, 1); // column pull-ups
+    }
+    sim_columns = 0x0F;
+    SIM_OnPin('H', 4, sim_trigger);
+    SIM_OnPort('C', sim_portc_written);
+    SIM_OnPin('K', 4, sim_buzzer_changed);
+    SIM_OnPin('K', 1, sim_green_changed);
+    SIM_OnUart(sim_uart_received);
+
+    // armed, nothing in range
+    SIM_RunMs(SIM_STARTUP_MS);
+
+    // serial command while idle
+    sim_reply = 0;
+    start = SIM_Now();
+    SIM_UartSend("stat\r");
+    SIM_Result("serial_command_to_reply", sim_wait(&sim_reply, start), "us");
+
+    // intruder
+    sim_distance_cm = SIM_NEAR_CM;
+    start = SIM_Now();
+    SIM_Result("intrusion_to_buzzer", sim_wait(&sim_buzzer_on, start), "us");
+
+    // passcode on the keypad, timed from the last key going down
+    SIM_RunMs(200);
+    sim_press(SIM_KEY_ENTER);
+    for (unsigned char i = 0; i < 3; i++) {
+        sim_press(sim_passcode[i]);
+    }
+    start = SIM_Now();
+    sim_key = sim_passcode[3];
+    sim_keypad_columns();
+    SIM_Result("passcode_to_disarm", sim_wait(&sim_green_on, start), "us");
+    sim_key = 0;
+    sim_keypad_columns();
+    SIM_RunMs(SIM_KEY_MS);
+    SIM_Result("buzzer_after_disarm", sim_buzzer, "");
+
+    SIM_Report();
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+  sim_ir.c
+
+  The IR firmware in simavr: an IR receiver module on PL0 (ICP4), see sim.h.
+    sim_ir build/os/ir.elf > build/os/sim_ir.json
+
+  Receiver: PL0 idles high and is low during a mark (carrier burst), as the
+  module's output. A NEC frame (leader, address, ~address, command,
+  ~command LSB first, stop mark) is played as a list of mark / space lengths,
+  each edge scheduled by the previous one; 108 ms after the frame starts a
+  repeat frame follows, as while a key is held.
+
+  Results (us):
+    frame_to_reply      end of the stop mark -> "NEC 0004 08" line sent,
+                        includes the decoder, the event queue and the 13
+                        bytes on the line at 9600 baud
+    repeat_to_reply     end of the repeat's stop mark -> "NEC 0004 08 repeat"
+    frame_errors        1 if the frame was not decoded as sent (error)
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define SIM_CPU_HZ          16000000UL  // F_CPU of the IR firmware
+#define SIM_ADDRESS         0x04
+#define SIM_COMMAND         0x08
+#define SIM_LEADER_MARK_US  9000
+#define SIM_LEADER_SPACE_US 4500
+#define SIM_REPEAT_SPACE_US 2250
+#define SIM_BIT_MARK_US     562
+#define SIM_ZERO_SPACE_US   562
+#define SIM_ONE_SPACE_US    1687
+#define SIM_REPEAT_MS       108     // frame start to repeat start
+#define SIM_STARTUP_MS      500
+#define SIM_TIMEOUT_MS      2000    // a latency that has not happened by then is null
+
+static const char sim_frame_text[] = "NEC 0004 08\r";
+static const char sim_repeat_text[] = "NEC 0004 08 repeat\r";
+
+static unsigned int sim_lengths[2 + 2 * 32 + 1];    // mark, space, ..., stop mark (us)
+static unsigned char sim_length_count = 0;
+static unsigned char sim_length_next = 0;
+static avr_cycle_count_t sim_frame_end = 0;         // rising edge after the stop mark
+static avr_cycle_count_t sim_frame_line = 0;        // sim_frame_text complete
+static avr_cycle_count_t sim_repeat_line = 0;       // sim_repeat_text complete
+
+// - - - - - - - - - - - - - - - - -
+// receiver output: even steps are marks (low), odd steps spaces (high)
+static void sim_edge(void *param)
+{
+    if (sim_length_next == sim_length_count)
+    {
+        SIM_SetPin('L', 0, 1); // end of the stop mark
+        sim_frame_end = SIM_Now();
+        return;
+    }
+    SIM_SetPin('L', 0, sim_length_next & 1);
+    SIM_After(sim_lengths[sim_length_next++], sim_edge, NULL);
+}
+
+static void sim_frame(unsigned char iAddress, unsigned char iCommand)
+{
+    unsigned long data = iAddress | (unsigned long)(unsigned char)~iAddress << 8
+                         | (unsigned long)iCommand << 16 | (unsigned long)(unsigned char)~iCommand << 24;
+
+    sim_length_count = 0;
+    sim_lengths[sim_length_count++] = SIM_LEADER_MARK_US;
+    sim_lengths[sim_length_count++] = SIM_LEADER_SPACE_US;
+    for (unsigned char bit = 0; bit < 32; bit++)
+    {
+        sim_lengths[sim_length_count++] = SIM_BIT_MARK_US;
+        sim_lengths[sim_length_count++] = ((data >> bit) & 1) ? SIM_ONE_SPACE_US : SIM_ZERO_SPACE_US;
+    }
+    sim_lengths[sim_length_count++] = SIM_BIT_MARK_US;
+    sim_length_next = 0;
+    sim_edge(NULL);
+}
+
+static void sim_repeat()
+{
+    sim_length_count = 0;
+    sim_lengths[sim_length_count++] = SIM_LEADER_MARK_US;
+    sim_lengths[sim_length_count++] = SIM_REPEAT_SPACE_US;
+    sim_lengths[sim_length_count++] = SIM_BIT_MARK_US;
+    sim_length_next = 0;
+    sim_edge(NULL);
+}
+
+// - - - - - - - - - - - - - - - - -
+static int sim_uart_ends_with(const char *sText, unsigned int iLength)
+{
+    return sim_uart_length >= iLength
+           && memcmp(&sim_uart_log[sim_uart_length - iLength], sText, iLength) == 0;
+}
+
+static void sim_uart_received(unsigned char cByte)
+{
+    if (sim_frame_line == 0 && sim_uart_ends_with(sim_frame_text, sizeof(sim_frame_text) - 1)) {
+        sim_frame_line = SIM_Now();
+    }
+    if (sim_repeat_line == 0 && sim_uart_ends_with(sim_repeat_text, sizeof(sim_repeat_text) - 1)) {
+        sim_repeat_line = SIM_Now();
+    }
+}
+
+// run until *pWhen is set after *pStart (set meanwhile), returns the latency in us (NAN on timeout)
+static double sim_wait(avr_cycle_count_t *pWhen, avr_cycle_count_t *pStart)
+{
+    for (unsigned long ms = 0; ms < SIM_TIMEOUT_MS; ms++)
+    {
+        if (*pStart != 0 && *pWhen > *pStart) {
+            return SIM_CyclesToUs(*pWhen - *pStart);
+        }
+        SIM_RunMs(1);
+    }
+    return NAN;
+}
+
+int main(int argc, char *argv[])
+{
+    avr_cycle_count_t start;
+    double latency;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s ir.elf\n", argv[0]);
+        return 2;
+    }
+    SIM_Load(argv[1], SIM_CPU_HZ, "ir");
+    SIM_SetPin('L', 0, 1); // receiver idle
+    SIM_OnUart(sim_uart_received);
+    SIM_RunMs(SIM_STARTUP_MS);
+
+    start = SIM_Now();
+    sim_frame_end = 0;
+    sim_frame(SIM_ADDRESS, SIM_COMMAND);
+    latency = sim_wait(&sim_frame_line, &sim_frame_end);
+    SIM_Result("frame_to_reply", latency, "us");
+    SIM_Result("frame_errors", isnan(latency), "");
+
+    // the repeat starts SIM_REPEAT_MS after the frame did
+    if (SIM_Now() < start + SIM_REPEAT_MS * (SIM_CPU_HZ / 1000)) {
+        SIM_RunCycles(start + SIM_REPEAT_MS * (SIM_CPU_HZ / 1000) - SIM_Now());
+    }
+    sim_frame_end = 0;
+    sim_repeat();
+    SIM_Result("repeat_to_reply", sim_wait(&sim_repeat_line, &sim_frame_end), "us");
+
+    SIM_Report();
+    return 0;
+}
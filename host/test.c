@@ -0,0 +1,37 @@
+/*
+  test.c
+
+  Counts the checks of a host test and prints the ones that fail.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "test.h"
+
+static unsigned long test_checks = 0, test_fails = 0;
+
+// bOk false: print the message (printf format), count the failure; returns bOk
+int TEST_Check(int bOk, const char *sFormat, ...)
+{
+    va_list args;
+
+    test_checks++;
+    if (!bOk)
+    {
+        test_fails++;
+        printf("FAIL: ");
+        va_start(args, sFormat);
+        vprintf(sFormat, args);
+        va_end(args);
+        printf("\n");
+    }
+    return bOk;
+}
+
+// totals, and the exit status for main()
+int TEST_End(const char *sName)
+{
+    printf("%s: %lu checks, %lu failed\n", sName, test_checks, test_fails);
+    return test_fails != 0;
+}
@@ -0,0 +1,22 @@
+/*
+  test.h
+
+  Checks for the host tests (make test). Each test_<name>.c includes the
+  code under test the way bench_<firmware>.c does, feeds it known input and
+  compares the results:
+
+    TEST_Check(latest == 1023, "entry %u: latest %u", entry, latest);
+    return TEST_End("adc");
+
+  Every failed check is printed, TEST_End() prints the totals and returns
+  the exit status of the test (1 if any check failed), so make test stops
+  on the first test program that fails.
+*/
+
+#ifndef TEST_H
+#define TEST_H
+
+int TEST_Check(int bOk, const char *sFormat, ...);
+int TEST_End(const char *sName);
+
+#endif
@@ -0,0 +1,102 @@
+/*
+  test_adc.c
+
+  Host test of the ADC oversampling decimator in ADC_vect: known samples go
+  through the ISR for every ratio n = 0-4 (4^n conversions per result) and
+  each result must be sum >> n, stored in adc_result[].latest and the ring,
+  with the accumulator cleared for the next result.
+  The scan list is replaced by five entries converted on every pass, one per
+  ratio, so the ISR steps through them in order. Sequences: full scale
+  (n = 4 sums 261888, more than 16 bits), the LSB alternating around mid
+  scale (the half LSB that oversampling recovers) and zero right after
+  them (any sum left in the accumulator would show).
+*/
+
+#define main adc_main
+#define asm(x)
+#define ADC_SCAN_TABLE \
+{ \
+    { ADC_MUX(0), ADC_REF_AVCC, 1, 0, 0 }, \
+    { ADC_MUX(1), ADC_REF_AVCC, 1, 0, 1 }, \
+    { ADC_MUX(2), ADC_REF_AVCC, 1, 0, 2 }, \
+    { ADC_MUX(3), ADC_REF_AVCC, 1, 0, 3 }, \
+    { ADC_MUX(4), ADC_REF_AVCC, 1, 0, 4 }, \
+}
+#include "../ADC/adc_main.c"
+#undef main
+#undef asm
+
+#include "test.h"
+
+typedef struct
+{
+    const char *sName;
+    unsigned int (*sample)(unsigned int i);     // i-th conversion of a result
+    unsigned int (*expected)(unsigned char n);  // result at ratio n
+} TEST_Sequence;
+
+unsigned int test_full_scale(unsigned int i)        { return 1023; }
+unsigned int test_full_scale_result(unsigned char n) { return 1023U << n; }
+unsigned int test_alternating(unsigned int i)       { return 511 + (i & 1); }
+unsigned int test_alternating_result(unsigned char n) { return (511U << n) + (n ? 1U << (n - 1) : 0); }
+unsigned int test_zero(unsigned int i)              { return 0; }
+unsigned int test_zero_result(unsigned char n)      { return 0; }
+
+const TEST_Sequence test_sequences[] =
+{
+    { "full scale",      test_full_scale,  test_full_scale_result },
+    { "alternating LSB", test_alternating, test_alternating_result },
+    { "zero",            test_zero,        test_zero_result },
+};
+
+// 4^n conversions of one entry, then its result
+void test_result(unsigned char entry, const TEST_Sequence *pSequence)
+{
+    ADC_Result *pResult = &adc_result[entry];
+    unsigned char n = adc_scan[entry].oversample;
+    unsigned int conversions = 1U << (2 * n);
+    unsigned int count = pResult->count, latest = pResult->latest;
+    unsigned int expected = pSequence->expected(n);
+    unsigned long sum = 0;
+
+    TEST_Check(adc_current == entry, "%s n=%u: converting entry %u", pSequence->sName, n, adc_current);
+    for (unsigned int i = 0; i < conversions; i++)
+    {
+        ADC = pSequence->sample(i);
+        sum += pSequence->sample(i);
+        ADC_vect();
+        if (i + 1 < conversions)
+        {
+            // still accumulating: nothing stored, still on this entry
+            if (!TEST_Check(pResult->count == count && pResult->latest == latest
+                            && pResult->acc == sum && pResult->acc_count == i + 1 && adc_current == entry,
+                            "%s n=%u conversion %u: count %u latest %u acc %lu/%u, expected acc %lu/%u",
+                            pSequence->sName, n, i, pResult->count, pResult->latest,
+                            (unsigned long)pResult->acc, pResult->acc_count, sum, i + 1)) {
+                return;
+            }
+        }
+    }
+    TEST_Check(pResult->latest == expected, "%s n=%u: latest %u, expected %u",
+               pSequence->sName, n, pResult->latest, expected);
+    TEST_Check(pResult->ring[(pResult->head - 1) & ADC_RING_MASK] == expected, "%s n=%u: ring %u, expected %u",
+               pSequence->sName, n, pResult->ring[(pResult->head - 1) & ADC_RING_MASK], expected);
+    TEST_Check(pResult->count == count + 1, "%s n=%u: %u results, expected %u",
+               pSequence->sName, n, pResult->count, count + 1);
+    TEST_Check(pResult->acc == 0 && pResult->acc_count == 0, "%s n=%u: accumulator %lu/%u after the result",
+               pSequence->sName, n, (unsigned long)pResult->acc, pResult->acc_count);
+}
+
+int main()
+{
+    init_adc();
+    init_timer1();
+
+    for (unsigned char s = 0; s < sizeof(test_sequences) / sizeof(test_sequences[0]); s++)
+    {
+        for (unsigned char entry = 0; entry < ADC_SCAN_COUNT; entry++) {
+            test_result(entry, &test_sequences[s]);
+        }
+    }
+    return TEST_End("adc");
+}
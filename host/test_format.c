@@ -0,0 +1,115 @@
+/*
+  test_format.c
+
+  Host test of common/format.h: every FMT_ function against snprintf with
+  the format it stands for. All 16-bit values for FMT_Uint / FMT_Int /
+  FMT_Hex, the 32-bit boundaries plus a pseudo-random sweep for FMT_Ulong /
+  FMT_Long / FMT_Hex / FMT_Fixed (0-12 decimals, past the 10 digits of a
+  32-bit value). The returned pointer must be the terminating 0.
+  int is 32 bits and long 64 bits on the host: the values are cast to the
+  AVR's 16 / 32-bit types first, as the firmware would pass them.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../common/format.h"
+#include "test.h"
+
+#define TEST_RANDOM     1000000 // pseudo-random 32-bit values per function
+
+// compare one FMT_ result (and its end pointer) with the snprintf text
+void test_compare(const char *sCall, unsigned long v, const char *sLine, const char *pEnd, const char *sExpected)
+{
+    TEST_Check(strcmp(sLine, sExpected) == 0 && pEnd == sLine + strlen(sLine),
+               "%s(%lu): \"%s\" (length %d), expected \"%s\"",
+               sCall, v, sLine, (int)(pEnd - sLine), sExpected);
+}
+
+// fixed point reference: sign, integer part, 'decimals' places
+void test_fixed(int32_t v, unsigned char decimals)
+{
+    char sLine[32], sExpected[48], *pEnd;
+    uint64_t scale = 1, u = (v < 0) ? -(int64_t)v : v;
+
+    for (unsigned char i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    if (decimals == 0) {
+        snprintf(sExpected, sizeof(sExpected), "%ld", (long)v);
+    }
+    else {
+        snprintf(sExpected, sizeof(sExpected), "%s%llu.%0*llu", (v < 0) ? "-" : "",
+                 (unsigned long long)(u / scale), decimals % 16, (unsigned long long)(u % scale));
+    }
+    pEnd = FMT_Fixed(sLine, v, decimals);
+    TEST_Check(strcmp(sLine, sExpected) == 0 && pEnd == sLine + strlen(sLine),
+               "FMT_Fixed(%ld, %u): \"%s\", expected \"%s\"", (long)v, decimals, sLine, sExpected);
+}
+
+void test_32bit(uint32_t v)
+{
+    char sLine[32], sExpected[32], *pEnd;
+
+    pEnd = FMT_Ulong(sLine, v);
+    snprintf(sExpected, sizeof(sExpected), "%lu", (unsigned long)v);
+    test_compare("FMT_Ulong", v, sLine, pEnd, sExpected);
+
+    pEnd = FMT_Long(sLine, (int32_t)v);
+    snprintf(sExpected, sizeof(sExpected), "%ld", (long)(int32_t)v);
+    test_compare("FMT_Long", v, sLine, pEnd, sExpected);
+
+    for (unsigned char digits = 1; digits <= 8; digits++)
+    {
+        pEnd = FMT_Hex(sLine, v, digits);
+        snprintf(sExpected, sizeof(sExpected), "%0*lX", digits,
+                 (unsigned long)(v & (0xFFFFFFFFUL >> (32 - 4 * digits))));
+        test_compare("FMT_Hex", v, sLine, pEnd, sExpected);
+    }
+    for (unsigned char decimals = 0; decimals <= 12; decimals++) {
+        test_fixed((int32_t)v, decimals);
+    }
+}
+
+int main()
+{
+    char sLine[32], sExpected[32], *pEnd;
+    const uint32_t boundaries[] =
+    {
+        0, 1, 9, 10, 99, 100, 9999, 10000, 65535, 65536, 99999, 100000, 999999, 1000000,
+        9999999, 10000000, 99999999, 100000000, 999999999, 1000000000,
+        0x7FFFFFFFUL, 0x80000000UL, 0x80000001UL, 0xFFFFFFFFUL,
+    };
+    uint32_t random = 12345;
+
+    for (uint32_t v = 0; v <= 0xFFFF; v++)
+    {
+        pEnd = FMT_Uint(sLine, v);
+        snprintf(sExpected, sizeof(sExpected), "%u", (unsigned int)v);
+        test_compare("FMT_Uint", v, sLine, pEnd, sExpected);
+
+        pEnd = FMT_Int(sLine, (int16_t)v);
+        snprintf(sExpected, sizeof(sExpected), "%d", (int)(int16_t)v);
+        test_compare("FMT_Int", v, sLine, pEnd, sExpected);
+
+        pEnd = FMT_Hex(sLine, v, 4);
+        snprintf(sExpected, sizeof(sExpected), "%04X", (unsigned int)v);
+        test_compare("FMT_Hex", v, sLine, pEnd, sExpected);
+    }
+    for (unsigned char i = 0; i < sizeof(boundaries) / sizeof(boundaries[0]); i++)
+    {
+        test_32bit(boundaries[i]);
+        test_32bit(-boundaries[i]);
+    }
+    for (unsigned long i = 0; i < TEST_RANDOM; i++)
+    {
+        random = random * 1664525UL + 1013904223UL; // LCG, the same values on every run
+        test_32bit(random >> (random & 31));        // every length, not only 10 digits
+    }
+
+    pEnd = FMT_Text(sLine, "Sensor");
+    pEnd = FMT_Text(pEnd, ": ");
+    test_compare("FMT_Text", 0, sLine, pEnd, "Sensor: ");
+    return TEST_End("format");
+}
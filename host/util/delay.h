@@ -0,0 +1,23 @@
+/*
+  util/delay.h for the host build: busy-waits are not spent, only added up
+  in host_delay_us (reported as cycles at F_CPU by the benchmark).
+*/
+
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#include "../host_io.h"
+
+static inline void _delay_us(double us)
+{
+    if (!host_quiet) {
+        host_delay_us += us;
+    }
+}
+
+static inline void _delay_ms(double ms)
+{
+    _delay_us(ms * 1000.0);
+}
+
+#endif